@@ -0,0 +1,167 @@
+#pragma once
+
+#include "frozen_trie.hpp"
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <utility>
+
+// Multi-pattern matcher: the keys of a trie, frozen, plus Aho-Corasick links.
+// The failure link of a node points to the node of its longest proper suffix
+// that is also in the trie, and its output link to the nearest key along the
+// failure chain. A scan follows one transition per character of the text
+// (plus failure hops, amortized constant) and reports every occurrence of
+// every key, so it is linear in the text and the number of matches.
+template <class CharT = char, class Traits = std::char_traits<CharT>>
+class aho_corasick
+{
+	using view_type = impl_::flat_trie_view<CharT, Traits>;
+public:
+	using size_type = typename view_type::size_type;
+	using string = std::basic_string<CharT, Traits>;
+	using string_view = std::basic_string_view<CharT, Traits>;
+
+	static constexpr size_type npos = view_type::npos;
+	static constexpr size_type root = view_type::root;
+
+	// Scans text fed to it in consecutive chunks, as if they were one string:
+	// matches that straddle a chunk boundary are found too. Holds a pointer
+	// to the automaton, which must outlive it.
+	class scanner
+	{
+	public:
+		explicit scanner(const aho_corasick &ac) : ac_(&ac) {}
+
+		// Calls f(pos, match) for every key that ends in chunk, where pos is
+		// the offset of its first character from the start of the stream and
+		// match views the key, in memory owned by the automaton. Matches come
+		// in the order in which they end, the longest first when several end
+		// at the same character.
+		template <class F>
+		void feed(string_view chunk, F &&f) {
+			const view_type v = ac_->trie_.view();
+			for (size_t j = 0, len = chunk.length(); j < len; ++j) {
+				state_ = ac_->next_(v, state_, chunk[j]);
+				size_t end = offset_ + j + 1;
+				size_type first = state_ != root && v.marked(state_) ? state_ : ac_->output_[state_];
+				for (size_type m = first; m != npos; m = ac_->output_[m]) {
+					string_view key = ac_->key(m);
+					f(end - key.length(), key);
+				}
+			}
+			offset_ += chunk.length();
+		}
+
+		// Characters fed so far.
+		size_t position() const {
+			return offset_;
+		}
+
+		// Starts a new stream.
+		void reset() {
+			state_ = root;
+			offset_ = 0;
+		}
+
+	private:
+		const aho_corasick *ac_;
+		size_type state_ = root;
+		size_t offset_ = 0;
+	};
+
+	template <size_t MaxNodeDepth, template <class, class, class> class Storage, template <class> class Accessor, template <class, class> class Links>
+	explicit aho_corasick(const trie<CharT, MaxNodeDepth, Traits, Storage, Accessor, Links> &t) : trie_(t) {
+		const view_type v = trie_.view();
+		size_type count = v.node_count();
+		std::vector<size_type> parent(count, npos);
+		fail_.assign(count, root);
+		output_.assign(count, npos);
+		key_offset_.assign(count, 0);
+		depth_.assign(count, 0);
+
+		// Breadth-first order: a node's failure link is shorter than the node,
+		// so it is always settled before the node is.
+		for (size_type n = 0; n < count; ++n) {
+			if (n != root) {
+				size_type f = fail_[n];
+				output_[n] = v.marked(f) && f != root ? f : output_[f];
+			}
+			for (size_type child = v.first_child(n); child != v.first_child(n + 1); ++child) {
+				parent[child] = n;
+				depth_[child] = depth_[n] + 1;
+				if (n != root) fail_[child] = next_(v, fail_[n], v.value(child));
+			}
+		}
+
+		// The keys themselves, so that matches can be reported as views even
+		// when the text they were found in is gone. The root is marked in
+		// every trie, but the empty key is never reported.
+		for (size_type n = 1; n < count; ++n) {
+			if (!v.marked(n)) continue;
+			key_offset_[n] = static_cast<size_type>(keys_.size());
+			keys_.resize(keys_.size() + depth_[n]);
+			for (size_type m = n, j = depth_[n]; m != root; m = parent[m]) {
+				keys_[key_offset_[n] + --j] = v.value(m);
+			}
+		}
+	}
+
+	// Calls f(pos, match) for every occurrence of a key in text; see
+	// scanner::feed.
+	template <class F>
+	void scan(string_view text, F &&f) const {
+		scanner{ *this }.feed(text, std::forward<F>(f));
+	}
+
+	// Every occurrence of a key in text, as (pos, match) pairs.
+	std::vector<std::pair<size_t, string_view>> find_all(string_view text) const {
+		std::vector<std::pair<size_t, string_view>> results;
+		scan(text, [&](size_t pos, string_view match) {
+			results.emplace_back(pos, match);
+		});
+		return results;
+	}
+
+	// The key spelled out by a marked node.
+	string_view key(size_type n) const {
+		return { keys_.data() + key_offset_[n], depth_[n] };
+	}
+
+	size_type failure(size_type n) const {
+		return fail_[n];
+	}
+
+	size_t size() const {
+		return trie_.size();
+	}
+
+	size_t memory_usage() const {
+		return trie_.memory_usage()
+			+ (fail_.capacity() + output_.capacity() + key_offset_.capacity() + depth_.capacity()) * sizeof(size_type)
+			+ keys_.capacity() * sizeof(CharT);
+	}
+
+private:
+	// Goto function: the child of state on c, or else that of the longest
+	// suffix of state that has one, or else the root.
+	size_type next_(const view_type &v, size_type state, CharT c) const {
+		for (;;) {
+			size_type child = v.get_child(state, c);
+			if (child != npos) return child;
+			if (state == root) return root;
+			state = fail_[state];
+		}
+	}
+
+	frozen_trie<CharT, Traits> trie_;
+	std::vector<size_type> fail_;
+	// Nearest marked node along the failure chain, not counting the node.
+	std::vector<size_type> output_;
+	std::vector<size_type> key_offset_;
+	std::vector<size_type> depth_;
+	string keys_;
+};
+
+template <class CharT, size_t MaxNodeDepth, class Traits, template <class, class, class> class Storage, template <class> class Accessor, template <class, class> class Links>
+aho_corasick(const trie<CharT, MaxNodeDepth, Traits, Storage, Accessor, Links> &) -> aho_corasick<CharT, Traits>;
@@ -0,0 +1,561 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <utility>
+#include <type_traits>
+#include <cstdint>
+
+namespace impl_
+{
+// Epoch-based reclamation. A reader publishes the epoch it started in for as
+// long as it holds pointers into the structure; memory retired by the writer
+// is only freed once every published epoch is newer than the retirement.
+class epoch_domain
+{
+public:
+	static constexpr size_t max_readers = 128;
+
+	class guard
+	{
+	public:
+		guard(const guard &) = delete;
+		guard &operator=(const guard &) = delete;
+
+		~guard() {
+			slot_->store(0, std::memory_order_release);
+		}
+
+	private:
+		friend class epoch_domain;
+		explicit guard(std::atomic<std::uint64_t> *slot) : slot_(slot) {}
+
+		std::atomic<std::uint64_t> *slot_;
+	};
+
+	epoch_domain() = default;
+	epoch_domain(const epoch_domain &) = delete;
+	epoch_domain &operator=(const epoch_domain &) = delete;
+
+	// Claims a free reader slot. Never waits unless more than max_readers
+	// threads are reading at the same time; then it yields the CPU after
+	// every full pass over the slots that finds none free, so that the
+	// readers it is waiting for can run and release theirs.
+	guard pin() {
+		static thread_local size_t hint = std::hash<std::thread::id>{}(std::this_thread::get_id());
+		for (size_t j = hint;; ++j) {
+			auto &slot = slots_[j % max_readers].epoch;
+			std::uint64_t expected = 0;
+			if (slot.load(std::memory_order_relaxed) == 0 &&
+				slot.compare_exchange_strong(expected, global_.load())) {
+				hint = j;
+				return guard{ &slot };
+			}
+			if ((j + 1 - hint) % max_readers == 0) std::this_thread::yield();
+		}
+	}
+
+	std::uint64_t current() const {
+		return global_.load();
+	}
+
+	// Starts a new epoch and returns the oldest one still pinned by a reader.
+	std::uint64_t advance() {
+		std::uint64_t oldest = global_.fetch_add(1) + 1;
+		for (auto &slot : slots_) {
+			std::uint64_t epoch = slot.epoch.load();
+			if (epoch != 0) oldest = std::min(oldest, epoch);
+		}
+		return oldest;
+	}
+
+private:
+	struct alignas(64) slot
+	{
+		std::atomic<std::uint64_t> epoch{ 0 };
+	};
+
+	slot slots_[max_readers];
+	std::atomic<std::uint64_t> global_{ 1 };
+};
+
+// Immutable once published: writers copy the path they change.
+template <class CharT>
+struct persistent_node
+{
+	std::vector<std::pair<CharT, const persistent_node *>> children;
+	bool marked = false;
+};
+
+// Node of an insert-only trie. Children form a singly linked list sorted by
+// value, and every link is only ever swung from one node to a newer one, so
+// readers can follow them without synchronization beyond acquire loads.
+// A list costs one dependent load per sibling passed, so a trie over bytes
+// moves the children of a node that grows wide into an index with a slot per
+// byte value (see concurrent_insert_trie). It first seals the list by setting
+// the low bit of every link, which stops inserts into it, then builds the
+// index from the sealed list and publishes it. From then on the index holds
+// every child and the list is only a stale copy. An index takes 2 KiB, so
+// only nodes with many children get one.
+template <class CharT>
+struct lock_free_node
+{
+	struct child_index
+	{
+		std::atomic<lock_free_node *> slots[256]{};
+	};
+
+	explicit lock_free_node(CharT val) : value(val) {}
+
+	~lock_free_node() {
+		if (child_index *idx = index.load(std::memory_order_relaxed)) {
+			for (auto &slot : idx->slots) {
+				delete slot.load(std::memory_order_relaxed);
+			}
+			delete idx;
+			return;
+		}
+		lock_free_node *child = unsealed(first_child.load(std::memory_order_relaxed));
+		while (child) {
+			lock_free_node *next = unsealed(child->next_sibling.load(std::memory_order_relaxed));
+			delete child;
+			child = next;
+		}
+	}
+
+	static bool sealed(const lock_free_node *link) {
+		return reinterpret_cast<std::uintptr_t>(link) & 1;
+	}
+
+	static lock_free_node *sealed_copy(lock_free_node *link) {
+		return reinterpret_cast<lock_free_node *>(reinterpret_cast<std::uintptr_t>(link) | 1);
+	}
+
+	static lock_free_node *unsealed(lock_free_node *link) {
+		return reinterpret_cast<lock_free_node *>(reinterpret_cast<std::uintptr_t>(link) & ~std::uintptr_t{ 1 });
+	}
+
+	const CharT value;
+	std::atomic<bool> marked{ false };
+	// Children linked into the list, counted while the node may still need
+	// an index.
+	std::atomic<std::uint32_t> fanout{ 0 };
+	std::atomic<lock_free_node *> first_child{ nullptr };
+	std::atomic<lock_free_node *> next_sibling{ nullptr };
+	std::atomic<child_index *> index{ nullptr };
+};
+
+// Counter split over cache lines so that concurrent increments from different
+// threads rarely touch the same one. Reads sum every shard.
+class sharded_counter
+{
+public:
+	static constexpr size_t shards = 16;
+
+	void increment() {
+		static thread_local size_t shard = std::hash<std::thread::id>{}(std::this_thread::get_id()) % shards;
+		shards_[shard].count.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	size_t load() const {
+		size_t total = 0;
+		for (const auto &s : shards_) {
+			total += s.count.load(std::memory_order_relaxed);
+		}
+		return total;
+	}
+
+private:
+	struct alignas(64) shard
+	{
+		std::atomic<size_t> count{ 0 };
+	};
+
+	shard shards_[shards];
+};
+} // namespace impl_
+
+/*****************************************************************************/
+
+// Trie for many concurrent readers and one writer at a time. Readers never
+// take a lock: they pin an epoch and walk an immutable snapshot. add and
+// remove copy the nodes along the key's path and publish a new root with a
+// single atomic store, and replaced nodes are freed once no reader can still
+// see them. Concurrent writers are serialized by a mutex.
+template <class CharT = char, class Traits = std::char_traits<CharT>>
+class concurrent_trie
+{
+	using node = impl_::persistent_node<CharT>;
+public:
+	using string = std::basic_string<CharT, Traits>;
+	using string_view = std::basic_string_view<CharT, Traits>;
+
+	concurrent_trie() : root_(new node{}) {}
+	concurrent_trie(const concurrent_trie &) = delete;
+	concurrent_trie &operator=(const concurrent_trie &) = delete;
+
+	~concurrent_trie() {
+		destroy_(root_.load());
+		for (auto &r : retired_) {
+			delete r.second;
+		}
+	}
+
+	void add(string_view s) {
+		std::lock_guard<std::mutex> lock{ writer_ };
+		const node *root = root_.load();
+		if (contains_(root, s)) return;
+
+		std::vector<const node *> replaced;
+		const node *updated = insert_(root, s, replaced);
+		publish_(updated, replaced);
+		size_.fetch_add(1);
+	}
+
+	void remove(string_view s) {
+		std::lock_guard<std::mutex> lock{ writer_ };
+		const node *root = root_.load();
+		if (!contains_(root, s)) return;
+
+		std::vector<const node *> replaced;
+		const node *updated = erase_(root, s, replaced, true);
+		publish_(updated, replaced);
+		size_.fetch_sub(1);
+	}
+
+	bool contains(string_view s) const {
+		auto guard = epochs_.pin();
+		return contains_(root_.load(), s);
+	}
+
+	std::vector<string> complete_suggestions(string_view s) const {
+		auto guard = epochs_.pin();
+		const node *n = root_.load();
+		for (size_t j = 0; n && j < s.length(); ++j) {
+			n = get_child_(n, s[j]);
+		}
+		if (!n) return{};
+
+		std::vector<string> results;
+		string curr{ s };
+		if (n->marked) results.push_back(curr);
+		suggestions_impl(n, curr, results);
+		return results;
+	}
+
+	size_t size() const {
+		return size_.load();
+	}
+
+private:
+	static const node *get_child_(const node *n, CharT c) {
+		auto it = find_pos_(n->children, c);
+		return it != n->children.end() && Traits::eq(it->first, c) ? it->second : nullptr;
+	}
+
+	template <class Children>
+	static auto find_pos_(Children &children, CharT c) {
+		return std::lower_bound(children.begin(), children.end(), c, [](const auto &lhs, CharT rhs) {
+			return Traits::lt(lhs.first, rhs);
+		});
+	}
+
+	static bool contains_(const node *n, string_view s) {
+		for (size_t j = 0; n && j < s.length(); ++j) {
+			n = get_child_(n, s[j]);
+		}
+		return n && n->marked;
+	}
+
+	// Returns a copy of n with s added below it; the nodes it replaces are
+	// collected for retirement.
+	static node *insert_(const node *n, string_view s, std::vector<const node *> &replaced) {
+		node *copy = n ? new node(*n) : new node{};
+		if (n) replaced.push_back(n);
+		if (s.empty()) {
+			copy->marked = true;
+			return copy;
+		}
+
+		auto it = find_pos_(copy->children, s[0]);
+		if (it != copy->children.end() && Traits::eq(it->first, s[0])) {
+			it->second = insert_(it->second, s.substr(1), replaced);
+		}
+		else {
+			const node *child = insert_(nullptr, s.substr(1), replaced);
+			copy->children.insert(it, { s[0], child });
+		}
+		return copy;
+	}
+
+	// Returns a copy of n with s removed, or nullptr if the copy would be an
+	// unmarked leaf. s must be present.
+	static node *erase_(const node *n, string_view s, std::vector<const node *> &replaced, bool is_root) {
+		replaced.push_back(n);
+		node *copy = new node(*n);
+		if (s.empty()) {
+			copy->marked = false;
+		}
+		else {
+			auto it = find_pos_(copy->children, s[0]);
+			if (const node *child = erase_(it->second, s.substr(1), replaced, false)) {
+				it->second = child;
+			}
+			else {
+				copy->children.erase(it);
+			}
+		}
+
+		if (!is_root && !copy->marked && copy->children.empty()) {
+			delete copy;
+			return nullptr;
+		}
+		return copy;
+	}
+
+	void publish_(const node *root, const std::vector<const node *> &replaced) {
+		root_.store(root);
+		std::uint64_t epoch = epochs_.current();
+		for (const node *n : replaced) {
+			retired_.emplace_back(epoch, n);
+		}
+
+		std::uint64_t oldest = epochs_.advance();
+		auto alive = std::partition(retired_.begin(), retired_.end(), [=](const auto &r) {
+			return r.first >= oldest;
+		});
+		for (auto it = alive; it != retired_.end(); ++it) {
+			delete it->second;
+		}
+		retired_.erase(alive, retired_.end());
+	}
+
+	void suggestions_impl(const node *n, string &curr, std::vector<string> &results) const {
+		for (const auto &child : n->children) {
+			curr.push_back(child.first);
+			if (child.second->marked) results.push_back(curr);
+			suggestions_impl(child.second, curr, results);
+			curr.pop_back();
+		}
+	}
+
+	static void destroy_(const node *n) {
+		for (const auto &child : n->children) {
+			destroy_(child.second);
+		}
+		delete n;
+	}
+
+	mutable impl_::epoch_domain epochs_;
+	std::atomic<const node *> root_;
+	std::atomic<size_t> size_{ 0 };
+
+	// Writer-only state.
+	std::mutex writer_;
+	std::vector<std::pair<std::uint64_t, const node *>> retired_;
+};
+
+/*****************************************************************************/
+
+// Insert-only trie for many concurrent writers. add never takes a lock: a
+// missing child is linked into its parent's sorted sibling list with a single
+// compare-and-swap, and a writer that loses the race simply continues from
+// the node that won. Readers may run alongside writers and see every key
+// whose add has returned. Over bytes in their natural order, a node that
+// reaches index_threshold children switches to an index (see
+// lock_free_node), so that lookups and inserts below wide nodes cost one
+// load instead of a walk of the siblings. Wider characters always use lists
+// and suit keys with small fan-out per level.
+template <class CharT = char, class Traits = std::char_traits<CharT>>
+class concurrent_insert_trie
+{
+	using node = impl_::lock_free_node<CharT>;
+	using child_index = typename node::child_index;
+public:
+	using string = std::basic_string<CharT, Traits>;
+	using string_view = std::basic_string_view<CharT, Traits>;
+
+	static constexpr std::uint32_t index_threshold = 16;
+
+	concurrent_insert_trie() = default;
+	concurrent_insert_trie(const concurrent_insert_trie &) = delete;
+	concurrent_insert_trie &operator=(const concurrent_insert_trie &) = delete;
+
+	// Returns true if s was not present yet.
+	bool add(string_view s) {
+		node *current = &root_;
+		for (CharT c : s) {
+			current = get_or_emplace_(current, c);
+		}
+		if (current->marked.load(std::memory_order_acquire) ||
+			current->marked.exchange(true, std::memory_order_acq_rel)) {
+			return false;
+		}
+		size_.increment();
+		return true;
+	}
+
+	bool contains(string_view s) const {
+		const node *n = find_prefix_(s);
+		return n && n->marked.load(std::memory_order_acquire);
+	}
+
+	std::vector<string> complete_suggestions(string_view s) const {
+		const node *n = find_prefix_(s);
+		if (!n) return{};
+
+		std::vector<string> results;
+		string curr{ s };
+		if (n->marked.load(std::memory_order_acquire)) results.push_back(curr);
+		suggestions_impl(n, curr, results);
+		return results;
+	}
+
+	size_t size() const {
+		return size_.load();
+	}
+
+private:
+	// The slots of an index are in byte order, which must be the key order.
+	static constexpr bool indexed_ = sizeof(CharT) == 1 && std::is_same_v<Traits, std::char_traits<CharT>>;
+
+	static size_t slot_(CharT c) {
+		return static_cast<unsigned char>(c);
+	}
+
+	// Moves past the children of a list that are less than c. Stops at a
+	// sealed link, which is returned as is.
+	static void skip_less_(std::atomic<node *> *&link, node *&child, CharT c) {
+		while (child && !node::sealed(child) && Traits::lt(child->value, c)) {
+			link = &child->next_sibling;
+			child = link->load(std::memory_order_acquire);
+		}
+	}
+
+	static const node *get_child_(const node *n, CharT c) {
+		if constexpr (indexed_) {
+			if (const child_index *idx = n->index.load(std::memory_order_acquire)) {
+				return idx->slots[slot_(c)].load(std::memory_order_acquire);
+			}
+		}
+		// A sealed list still holds every child that was linked before the
+		// index was published.
+		const node *child = node::unsealed(n->first_child.load(std::memory_order_acquire));
+		while (child && Traits::lt(child->value, c)) {
+			child = node::unsealed(child->next_sibling.load(std::memory_order_acquire));
+		}
+		return child && Traits::eq(child->value, c) ? child : nullptr;
+	}
+
+	static node *get_or_emplace_(node *n, CharT c) {
+		if constexpr (indexed_) {
+			if (child_index *idx = n->index.load(std::memory_order_acquire)) return emplace_indexed_(idx, c);
+		}
+		std::atomic<node *> *link = &n->first_child;
+		node *child = link->load(std::memory_order_acquire);
+		skip_less_(link, child, c);
+
+		node *created = nullptr;
+		for (;;) {
+			if (node::sealed(child)) {
+				// Another writer is switching n to an index; help it finish.
+				delete created;
+				return emplace_indexed_(index_of_(n), c);
+			}
+			if (child && Traits::eq(child->value, c)) {
+				delete created;
+				return child;
+			}
+			if (!created) created = new node{ c };
+			created->next_sibling.store(child, std::memory_order_relaxed);
+			if (link->compare_exchange_weak(child, created, std::memory_order_release, std::memory_order_acquire)) {
+				if constexpr (indexed_) {
+					if (n->fanout.fetch_add(1, std::memory_order_relaxed) + 1 == index_threshold) index_of_(n);
+				}
+				return created;
+			}
+			// Someone linked a node in the meantime. Links are never removed,
+			// so the search can resume from the same place.
+			skip_less_(link, child, c);
+		}
+	}
+
+	static node *emplace_indexed_(child_index *idx, CharT c) {
+		std::atomic<node *> &slot = idx->slots[slot_(c)];
+		node *child = slot.load(std::memory_order_acquire);
+		if (child) return child;
+		node *created = new node{ c };
+		if (slot.compare_exchange_strong(child, created, std::memory_order_release, std::memory_order_acquire)) {
+			return created;
+		}
+		delete created;
+		return child;
+	}
+
+	// Returns the index of n, building it first if need be: seals every link
+	// of the list, so that no child can be linked in any more, and publishes
+	// an index of the sealed list. Writers that meet a sealed link call this
+	// too, so a stalled writer cannot hold the others up.
+	static child_index *index_of_(node *n) {
+		if (child_index *idx = n->index.load(std::memory_order_acquire)) return idx;
+		for (std::atomic<node *> *link = &n->first_child;;) {
+			node *child = link->load(std::memory_order_acquire);
+			while (!node::sealed(child) &&
+				!link->compare_exchange_weak(child, node::sealed_copy(child), std::memory_order_acq_rel, std::memory_order_acquire)) {
+			}
+			child = node::unsealed(child);
+			if (!child) break;
+			link = &child->next_sibling;
+		}
+
+		auto *built = new child_index{};
+		for (node *child = node::unsealed(n->first_child.load(std::memory_order_acquire)); child;
+			child = node::unsealed(child->next_sibling.load(std::memory_order_acquire))) {
+			built->slots[slot_(child->value)].store(child, std::memory_order_relaxed);
+		}
+		child_index *expected = nullptr;
+		if (n->index.compare_exchange_strong(expected, built, std::memory_order_acq_rel, std::memory_order_acquire)) {
+			return built;
+		}
+		delete built;
+		return expected;
+	}
+
+	const node *find_prefix_(string_view s) const {
+		const node *n = &root_;
+		for (size_t j = 0; n && j < s.length(); ++j) {
+			n = get_child_(n, s[j]);
+		}
+		return n;
+	}
+
+	void suggestions_impl(const node *n, string &curr, std::vector<string> &results) const {
+		auto visit = [&](const node *child) {
+			curr.push_back(child->value);
+			if (child->marked.load(std::memory_order_acquire)) results.push_back(curr);
+			suggestions_impl(child, curr, results);
+			curr.pop_back();
+		};
+		if constexpr (indexed_) {
+			if (const child_index *idx = n->index.load(std::memory_order_acquire)) {
+				for (const auto &slot : idx->slots) {
+					if (const node *child = slot.load(std::memory_order_acquire)) visit(child);
+				}
+				return;
+			}
+		}
+		for (const node *child = node::unsealed(n->first_child.load(std::memory_order_acquire)); child;
+			child = node::unsealed(child->next_sibling.load(std::memory_order_acquire))) {
+			visit(child);
+		}
+	}
+
+	node root_{ CharT{} };
+	impl_::sharded_counter size_;
+};
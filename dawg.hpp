@@ -0,0 +1,277 @@
+#pragma once
+
+#include "trie.hpp"
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <algorithm>
+#include <unordered_set>
+#include <functional>
+#include <stdexcept>
+#include <cstdint>
+
+// Minimal acyclic automaton (DAWG) over a fixed key set: a trie in which
+// equivalent subtries, those that accept the same suffixes, are merged into
+// one state. Keys that share endings, such as URLs or inflected words, then
+// share the states of those endings, which a trie duplicates per prefix.
+// It is built in one pass over sorted keys with Daciuk's incremental
+// minimization, and stored like frozen_trie: the edges of state s are the
+// contiguous range [first_edge[s], first_edge[s + 1]), sorted by label, each
+// with the state it leads to. Read-only.
+template <class CharT = char, class Traits = std::char_traits<CharT>>
+class dawg
+{
+public:
+	using size_type = std::uint32_t;
+	using string = std::basic_string<CharT, Traits>;
+	using string_view = std::basic_string_view<CharT, Traits>;
+
+	static constexpr size_type npos = static_cast<size_type>(-1);
+	static constexpr size_type root = 0;
+
+	// An empty automaton.
+	dawg() : first_edge_{ 0, 0 }, marks_{ 0 } {}
+
+	// Builds the automaton of a range of keys sorted by Traits::compare
+	// (duplicates allowed). Throws std::invalid_argument if the keys are out
+	// of order.
+	template <class ForwardIt>
+	dawg(ForwardIt first, ForwardIt last) {
+		builder_ b;
+		for (; first != last; ++first) {
+			b.add(string_view{ *first });
+		}
+		b.finish();
+		size_ = b.size;
+		flatten_(b);
+	}
+
+	// The state reached by s, or npos.
+	size_type find_prefix(string_view s) const {
+		size_type current = root;
+		for (size_t j = 0, len = s.length(); j < len && current != npos; ++j) {
+			current = get_child(current, s[j]);
+		}
+		return current;
+	}
+
+	bool contains(string_view s) const {
+		size_type n = find_prefix(s);
+		return n != npos && marked(n);
+	}
+
+	// Same order as trie::complete_suggestions: s itself first if present,
+	// then the other keys depth first.
+	std::vector<string> complete_suggestions(string_view s) const {
+		size_type n = find_prefix(s);
+		if (n == npos) return {};
+
+		std::vector<string> results;
+		if (marked(n)) results.emplace_back(s);
+
+		struct frame { size_type next, end; };
+		std::vector<frame> stack{ { first_edge_[n], first_edge_[n + 1] } };
+		string curr{ s };
+		while (!stack.empty()) {
+			frame &f = stack.back();
+			if (f.next == f.end) {
+				stack.pop_back();
+				if (!stack.empty()) curr.pop_back();
+				continue;
+			}
+			size_type edge = f.next++;
+			size_type target = targets_[edge];
+			curr.push_back(labels_[edge]);
+			if (marked(target)) results.push_back(curr);
+			stack.push_back({ first_edge_[target], first_edge_[target + 1] });
+		}
+		return results;
+	}
+
+	// Same semantics as trie::closest_matches. A shared state is walked once
+	// for every path into it, with the rows of that path.
+	std::vector<string> closest_matches(string_view s, unsigned changes = 1, bool transpositions = false) const {
+		std::vector<string> results;
+		impl_::edit_distance_rows<CharT, Traits> rows{ s, changes, transpositions };
+		closest_impl(root, rows, changes, results);
+		return results;
+	}
+
+	size_type get_child(size_type n, CharT ch) const {
+		const CharT *first = labels_.data() + first_edge_[n];
+		const CharT *last = labels_.data() + first_edge_[n + 1];
+		const CharT *pos = std::lower_bound(first, last, ch, [](CharT lhs, CharT rhs) {
+			return Traits::lt(lhs, rhs);
+		});
+		if (pos == last || !Traits::eq(*pos, ch)) return npos;
+		return targets_[pos - labels_.data()];
+	}
+
+	bool marked(size_type n) const {
+		return (marks_[n / 64] >> (n % 64)) & 1;
+	}
+
+	size_t size() const {
+		return size_;
+	}
+
+	size_type state_count() const {
+		return static_cast<size_type>(first_edge_.size() - 1);
+	}
+
+	size_type edge_count() const {
+		return static_cast<size_type>(labels_.size());
+	}
+
+	size_t memory_usage() const {
+		return labels_.capacity() * sizeof(CharT)
+			+ (targets_.capacity() + first_edge_.capacity()) * sizeof(size_type)
+			+ marks_.capacity() * sizeof(std::uint64_t);
+	}
+
+private:
+	// States under construction. Those on the path of the last key added
+	// can still change; every other live state is in the registry, which
+	// finds an equivalent state (same finality, same edges to the same
+	// states) in constant time.
+	struct builder_
+	{
+		struct state
+		{
+			bool final = false;
+			std::vector<std::pair<CharT, size_type>> edges;
+		};
+
+		struct state_hash
+		{
+			size_t operator () (size_type s) const {
+				const state &st = (*states)[s];
+				size_t h = st.final;
+				for (const auto &[label, target] : st.edges) {
+					h = h * 1000003 ^ std::hash<CharT>{}(label);
+					h = h * 1000003 ^ target;
+				}
+				return h;
+			}
+			const std::vector<state> *states;
+		};
+
+		struct state_equal
+		{
+			bool operator () (size_type lhs, size_type rhs) const {
+				const state &l = (*states)[lhs];
+				const state &r = (*states)[rhs];
+				return l.final == r.final && l.edges.size() == r.edges.size() &&
+					std::equal(l.edges.begin(), l.edges.end(), r.edges.begin(), [](const auto &a, const auto &b) {
+						return Traits::eq(a.first, b.first) && a.second == b.second;
+					});
+			}
+			const std::vector<state> *states;
+		};
+
+		builder_() : states(1), registry(0, state_hash{ &states }, state_equal{ &states }), path{ root } {}
+
+		void add(string_view key) {
+			size_t common = 0;
+			if (size > 0) {
+				int order = string_view{ last }.compare(key);
+				if (order > 0) throw std::invalid_argument("dawg: keys are not sorted");
+				if (order == 0) return;
+				while (common < last.size() && common < key.size() && Traits::eq(last[common], key[common])) {
+					++common;
+				}
+			}
+			minimize(common);
+			for (size_t j = common, len = key.length(); j < len; ++j) {
+				size_type s = new_state();
+				states[path.back()].edges.emplace_back(key[j], s);
+				path.push_back(s);
+			}
+			states[path.back()].final = true;
+			last.assign(key.data(), key.size());
+			++size;
+		}
+
+		void finish() {
+			minimize(0);
+		}
+
+		// Registers the states of the last key below depth keep, bottom up,
+		// replacing each with an equivalent registered state if there is one.
+		// Freed states are recycled by new_state.
+		void minimize(size_t keep) {
+			for (size_t j = path.size() - 1; j > keep; --j) {
+				size_type s = path[j];
+				auto [it, inserted] = registry.insert(s);
+				if (!inserted) {
+					states[path[j - 1]].edges.back().second = *it;
+					states[s].final = false;
+					states[s].edges.clear();
+					free_states.push_back(s);
+				}
+			}
+			path.resize(keep + 1);
+		}
+
+		size_type new_state() {
+			if (!free_states.empty()) {
+				size_type s = free_states.back();
+				free_states.pop_back();
+				return s;
+			}
+			states.emplace_back();
+			return static_cast<size_type>(states.size() - 1);
+		}
+
+		std::vector<state> states;
+		std::unordered_set<size_type, state_hash, state_equal> registry;
+		std::vector<size_type> path;
+		std::vector<size_type> free_states;
+		string last;
+		size_t size = 0;
+	};
+
+	// Numbers the live states breadth first from the root and lays out their
+	// edges.
+	void flatten_(const builder_ &b) {
+		std::vector<size_type> id(b.states.size(), npos);
+		std::vector<size_type> order{ root };
+		id[root] = 0;
+		for (size_t head = 0; head < order.size(); ++head) {
+			const auto &st = b.states[order[head]];
+			first_edge_.push_back(static_cast<size_type>(labels_.size()));
+			if (head % 64 == 0) marks_.push_back(0);
+			if (st.final) marks_.back() |= std::uint64_t{ 1 } << (head % 64);
+			for (const auto &[label, target] : st.edges) {
+				if (id[target] == npos) {
+					id[target] = static_cast<size_type>(order.size());
+					order.push_back(target);
+				}
+				labels_.push_back(label);
+				targets_.push_back(id[target]);
+			}
+		}
+		first_edge_.push_back(static_cast<size_type>(labels_.size()));
+		labels_.shrink_to_fit();
+		targets_.shrink_to_fit();
+		first_edge_.shrink_to_fit();
+		marks_.shrink_to_fit();
+	}
+
+	void closest_impl(size_type n, impl_::edit_distance_rows<CharT, Traits> &rows, unsigned changes, std::vector<string> &results) const {
+		for (size_type edge = first_edge_[n]; edge != first_edge_[n + 1]; ++edge) {
+			size_type target = targets_[edge];
+			unsigned row_min = rows.push(labels_[edge]);
+			if (marked(target) && rows.distance() <= changes) results.push_back(rows.candidate());
+			if (row_min <= changes && first_edge_[target] != first_edge_[target + 1]) closest_impl(target, rows, changes, results);
+			rows.pop();
+		}
+	}
+
+	std::vector<CharT> labels_;
+	std::vector<size_type> targets_;
+	std::vector<size_type> first_edge_;
+	std::vector<std::uint64_t> marks_;
+	size_t size_ = 0;
+};
@@ -0,0 +1,321 @@
+#pragma once
+
+#include "trie.hpp"
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+#include <random>
+#include <system_error>
+#include <stdexcept>
+
+namespace impl_
+{
+// Read-only view over a trie laid out in breadth-first order. The children of
+// node i are the contiguous range [first_child[i], first_child[i + 1]), sorted
+// by label, so a lookup is a binary search over a handful of adjacent labels.
+// The view does not own its arrays, which lets the same query code run over
+// vectors or over a mapped file.
+template <class CharT, class Traits>
+class flat_trie_view
+{
+public:
+	using size_type = std::uint32_t;
+	using string = std::basic_string<CharT, Traits>;
+	using string_view = std::basic_string_view<CharT, Traits>;
+
+	static constexpr size_type npos = static_cast<size_type>(-1);
+	static constexpr size_type root = 0;
+
+	flat_trie_view() = default;
+	flat_trie_view(const CharT *labels, const size_type *first_child, const std::uint64_t *marks, size_type node_count) :
+		labels_(labels), first_child_(first_child), marks_(marks), node_count_(node_count)
+	{}
+
+	size_type node_count() const {
+		return node_count_;
+	}
+
+	CharT value(size_type n) const {
+		return labels_[n];
+	}
+
+	bool marked(size_type n) const {
+		return (marks_[n / 64] >> (n % 64)) & 1;
+	}
+
+	bool leaf(size_type n) const {
+		return first_child_[n] == first_child_[n + 1];
+	}
+
+	// The children of n are the nodes [first_child(n), first_child(n + 1)).
+	size_type first_child(size_type n) const {
+		return first_child_[n];
+	}
+
+	size_type get_child(size_type n, CharT ch) const {
+		const CharT *first = labels_ + first_child_[n];
+		const CharT *last = labels_ + first_child_[n + 1];
+		const CharT *pos = std::lower_bound(first, last, ch, [](CharT lhs, CharT rhs) {
+			return Traits::lt(lhs, rhs);
+		});
+		if (pos == last || !Traits::eq(*pos, ch)) return npos;
+		return static_cast<size_type>(pos - labels_);
+	}
+
+	// Returns the node reached by s and the number of characters consumed.
+	std::pair<size_type, size_t> descend(string_view s) const {
+		size_type current = root;
+		for (size_t j = 0, len = s.length(); j < len; ++j) {
+			size_type next = get_child(current, s[j]);
+			if (next == npos) return { current, j };
+			current = next;
+		}
+		return { current, s.length() };
+	}
+
+	size_type find_prefix(string_view s, bool closest_match = false) const {
+		auto[n, depth] = descend(s);
+		return depth == s.length() || closest_match ? n : npos;
+	}
+
+	bool contains(string_view s) const {
+		size_type n = find_prefix(s);
+		return n != npos && marked(n);
+	}
+
+	std::vector<string> complete_suggestions(string_view s) const {
+		size_type n = find_prefix(s);
+		if (n == npos) return{};
+
+		std::vector<string> results;
+		if (marked(n)) results.emplace_back(s);
+
+		struct frame { size_type next, end; };
+		std::vector<frame> stack{ { first_child_[n], first_child_[n + 1] } };
+		string curr{ s };
+		while (!stack.empty()) {
+			frame &f = stack.back();
+			if (f.next == f.end) {
+				stack.pop_back();
+				if (!stack.empty()) curr.pop_back();
+				continue;
+			}
+			size_type child = f.next++;
+			curr.push_back(labels_[child]);
+			if (marked(child)) results.push_back(curr);
+			stack.push_back({ first_child_[child], first_child_[child + 1] });
+		}
+		return results;
+	}
+
+	// Same semantics as trie::closest_matches.
+	std::vector<string> closest_matches(string_view s, unsigned changes = 1, bool transpositions = false) const {
+		std::vector<string> results;
+		edit_distance_rows<CharT, Traits> rows{ s, changes, transpositions };
+		closest_impl(root, rows, changes, results);
+		return results;
+	}
+
+private:
+	void closest_impl(size_type n, edit_distance_rows<CharT, Traits> &rows, unsigned changes, std::vector<string> &results) const {
+		for (size_type child = first_child_[n]; child != first_child_[n + 1]; ++child) {
+			unsigned row_min = rows.push(labels_[child]);
+			if (marked(child) && rows.distance() <= changes) results.push_back(rows.candidate());
+			if (row_min <= changes && !leaf(child)) closest_impl(child, rows, changes, results);
+			rows.pop();
+		}
+	}
+
+	const CharT *labels_ = nullptr;
+	const size_type *first_child_ = nullptr;
+	const std::uint64_t *marks_ = nullptr;
+	size_type node_count_ = 0;
+};
+
+// On-disk format of a flat trie: this header, then the labels, the child
+// offsets and the mark bitmap, each section starting on an 8 byte boundary.
+// Integers are stored in the byte order of the writing machine.
+struct flat_trie_header
+{
+	static constexpr char expected_magic[8] = { 'T', 'R', 'I', 'E', 'F', 'L', 'A', 'T' };
+	static constexpr std::uint32_t current_version = 1;
+	static constexpr std::uint32_t byte_order_mark = 0x01020304;
+
+	char magic[8];
+	std::uint32_t version;
+	std::uint32_t byte_order;
+	std::uint32_t char_size;
+	std::uint32_t node_count;
+	std::uint64_t size;
+
+	bool valid() const {
+		return std::memcmp(magic, expected_magic, sizeof(magic)) == 0 &&
+			version == current_version && byte_order == byte_order_mark;
+	}
+};
+
+// Byte offsets of the sections of a flat trie file.
+struct flat_trie_layout
+{
+	template <class CharT>
+	static flat_trie_layout of(std::uint32_t node_count) {
+		flat_trie_layout l;
+		l.labels = align_(sizeof(flat_trie_header));
+		l.first_child = align_(l.labels + size_t{ node_count } * sizeof(CharT));
+		l.marks = align_(l.first_child + (size_t{ node_count } + 1) * sizeof(std::uint32_t));
+		l.end = l.marks + (size_t{ node_count } + 63) / 64 * sizeof(std::uint64_t);
+		return l;
+	}
+
+	size_t labels, first_child, marks, end;
+
+private:
+	static size_t align_(size_t offset) {
+		return (offset + 7) / 8 * 8;
+	}
+};
+} // namespace impl_
+
+/*****************************************************************************/
+
+// Immutable, compacted copy of a trie. Each node costs one label, one 32 bit
+// child offset and one mark bit, and the whole structure lives in three
+// contiguous arrays.
+template <class CharT = char, class Traits = std::char_traits<CharT>>
+class frozen_trie
+{
+	using view_type = impl_::flat_trie_view<CharT, Traits>;
+public:
+	using size_type = typename view_type::size_type;
+	using string = std::basic_string<CharT, Traits>;
+	using string_view = std::basic_string_view<CharT, Traits>;
+
+	static constexpr size_type npos = view_type::npos;
+
+	// An empty frozen_trie, equivalent to freezing an empty trie.
+	frozen_trie() : labels_{ CharT{} }, first_child_{ 1, 1 }, marks_{ 1 } {}
+
+	template <size_t MaxNodeDepth, template <class, class, class> class Storage, template <class> class Accessor, template <class, class> class Links>
+	explicit frozen_trie(const trie<CharT, MaxNodeDepth, Traits, Storage, Accessor, Links> &t) : size_(t.size()) {
+		using node = typename trie<CharT, MaxNodeDepth, Traits, Storage, Accessor, Links>::node;
+
+		// Breadth-first walk: the children of every node get consecutive ids.
+		std::vector<const node *> level{ t.find_prefix(string_view{}) };
+		labels_.push_back(CharT{});
+		push_mark_(level.front()->marked());
+
+		std::vector<const node *> children;
+		for (size_t head = 0; head < level.size(); ++head) {
+			first_child_.push_back(static_cast<size_type>(level.size()));
+
+			children.clear();
+			for (const node &child : level[head]->get_elements()) {
+				children.push_back(&child);
+			}
+			// Not every accessor keeps its children ordered.
+			std::sort(children.begin(), children.end(), [](const node *lhs, const node *rhs) {
+				return Traits::lt(lhs->value(), rhs->value());
+			});
+
+			for (const node *child : children) {
+				level.push_back(child);
+				labels_.push_back(child->value());
+				push_mark_(child->marked());
+			}
+		}
+		first_child_.push_back(static_cast<size_type>(level.size()));
+	}
+
+	size_type find_prefix(string_view s, bool closest_match = false) const {
+		return view().find_prefix(s, closest_match);
+	}
+
+	bool contains(string_view s) const {
+		return view().contains(s);
+	}
+
+	std::vector<string> complete_suggestions(string_view s) const {
+		return view().complete_suggestions(s);
+	}
+
+	std::vector<string> closest_matches(string_view s, unsigned changes = 1, bool transpositions = false) const {
+		return view().closest_matches(s, changes, transpositions);
+	}
+
+	size_t size() const {
+		return size_;
+	}
+
+	size_type node_count() const {
+		return static_cast<size_type>(labels_.size());
+	}
+
+	size_t memory_usage() const {
+		return labels_.capacity() * sizeof(CharT)
+			+ first_child_.capacity() * sizeof(size_type)
+			+ marks_.capacity() * sizeof(std::uint64_t);
+	}
+
+	view_type view() const {
+		return { labels_.data(), first_child_.data(), marks_.data(), node_count() };
+	}
+
+	// Writes the trie in the format read by mapped_trie (see mapped_trie.hpp).
+	// The file is written next to path, under a name of its own so that
+	// concurrent saves do not collide, and then renamed over it. Processes
+	// that have the old file mapped keep a consistent copy, and a failed
+	// write leaves path untouched. Throws std::runtime_error if the file
+	// cannot be written.
+	void save(const std::string &path) const {
+		impl_::flat_trie_header header{};
+		std::memcpy(header.magic, header.expected_magic, sizeof(header.magic));
+		header.version = header.current_version;
+		header.byte_order = header.byte_order_mark;
+		header.char_size = sizeof(CharT);
+		header.node_count = node_count();
+		header.size = size_;
+
+		auto layout = impl_::flat_trie_layout::of<CharT>(header.node_count);
+		const std::string tmp_path = path + "." + std::to_string(std::random_device{}()) + ".tmp";
+		std::ofstream out{ tmp_path, std::ios::binary | std::ios::trunc };
+		if (!out) throw std::runtime_error("frozen_trie: cannot open " + tmp_path);
+		auto write_at = [&](size_t offset, const void *data, size_t bytes) {
+			static const char padding[8] = {};
+			out.write(padding, offset - static_cast<size_t>(out.tellp()));
+			out.write(static_cast<const char *>(data), bytes);
+		};
+		write_at(0, &header, sizeof(header));
+		write_at(layout.labels, labels_.data(), labels_.size() * sizeof(CharT));
+		write_at(layout.first_child, first_child_.data(), first_child_.size() * sizeof(size_type));
+		write_at(layout.marks, marks_.data(), marks_.size() * sizeof(std::uint64_t));
+		out.close();
+		// Unlike std::rename, this replaces an existing file on Windows too.
+		std::error_code error;
+		if (out) std::filesystem::rename(tmp_path, path, error);
+		if (!out || error) {
+			std::filesystem::remove(tmp_path, error);
+			throw std::runtime_error("frozen_trie: cannot write " + path);
+		}
+	}
+
+private:
+	void push_mark_(bool marked) {
+		size_t n = labels_.size() - 1;
+		if (n % 64 == 0) marks_.push_back(0);
+		if (marked) marks_.back() |= std::uint64_t{ 1 } << (n % 64);
+	}
+
+	std::vector<CharT> labels_;
+	std::vector<size_type> first_child_;
+	std::vector<std::uint64_t> marks_;
+	size_t size_ = 0;
+};
+
+template <class CharT, size_t MaxNodeDepth, class Traits, template <class, class, class> class Storage, template <class> class Accessor, template <class, class> class Links>
+frozen_trie(const trie<CharT, MaxNodeDepth, Traits, Storage, Accessor, Links> &) -> frozen_trie<CharT, Traits>;
@@ -0,0 +1,204 @@
+#pragma once
+
+#include "frozen_trie.hpp"
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <stdexcept>
+#include <utility>
+#include <cstdint>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace impl_
+{
+// Read-only mapping of a whole file. Pages are shared with every other
+// process that maps the same file.
+class file_mapping
+{
+public:
+	file_mapping() = default;
+
+	explicit file_mapping(const std::string &path) {
+#ifdef _WIN32
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+			OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) fail_(path);
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file, &size)) {
+			CloseHandle(file);
+			fail_(path);
+		}
+		size_ = static_cast<size_t>(size.QuadPart);
+		HANDLE mapping = size_ ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+		CloseHandle(file);
+		if (!mapping) fail_(path);
+		data_ = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		CloseHandle(mapping);
+		if (!data_) fail_(path);
+#else
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0) fail_(path);
+		struct stat st;
+		if (::fstat(fd, &st) != 0 || st.st_size == 0) {
+			::close(fd);
+			fail_(path);
+		}
+		size_ = static_cast<size_t>(st.st_size);
+		void *data = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+		::close(fd);
+		if (data == MAP_FAILED) fail_(path);
+		data_ = data;
+#endif
+	}
+
+	file_mapping(file_mapping &&other) noexcept :
+		data_(std::exchange(other.data_, nullptr)), size_(std::exchange(other.size_, 0))
+	{}
+
+	file_mapping &operator=(file_mapping &&other) noexcept {
+		if (this != &other) {
+			unmap_();
+			data_ = std::exchange(other.data_, nullptr);
+			size_ = std::exchange(other.size_, 0);
+		}
+		return *this;
+	}
+
+	~file_mapping() {
+		unmap_();
+	}
+
+	const char *data() const {
+		return static_cast<const char *>(data_);
+	}
+
+	size_t size() const {
+		return size_;
+	}
+
+private:
+	[[noreturn]] static void fail_(const std::string &path) {
+		throw std::runtime_error("file_mapping: cannot map " + path);
+	}
+
+	void unmap_() {
+		if (!data_) return;
+#ifdef _WIN32
+		UnmapViewOfFile(data_);
+#else
+		::munmap(data_, size_);
+#endif
+		data_ = nullptr;
+	}
+
+	void *data_ = nullptr;
+	size_t size_ = 0;
+};
+} // namespace impl_
+
+/*****************************************************************************/
+
+// A trie saved with trie::save or frozen_trie::save, queried in place from a
+// memory mapped file. Opening validates the header and makes one pass over
+// the child offsets, so that no lookup can leave the mapping; nothing is
+// copied, and the other pages are read in by the OS as lookups touch them.
+template <class CharT = char, class Traits = std::char_traits<CharT>>
+class mapped_trie
+{
+	using view_type = impl_::flat_trie_view<CharT, Traits>;
+public:
+	using size_type = typename view_type::size_type;
+	using string = std::basic_string<CharT, Traits>;
+	using string_view = std::basic_string_view<CharT, Traits>;
+
+	static constexpr size_type npos = view_type::npos;
+
+	// Throws std::runtime_error if the file cannot be mapped, was not written
+	// for this character type and byte order, or is corrupt.
+	static mapped_trie open(const std::string &path) {
+		impl_::file_mapping file{ path };
+		if (file.size() < sizeof(impl_::flat_trie_header)) invalid_(path);
+
+		impl_::flat_trie_header header;
+		std::memcpy(&header, file.data(), sizeof(header));
+		if (!header.valid() || header.char_size != sizeof(CharT) || header.node_count == 0 ||
+			header.size > header.node_count) invalid_(path);
+
+		auto layout = impl_::flat_trie_layout::of<CharT>(header.node_count);
+		if (file.size() < layout.end) invalid_(path);
+
+		const char *base = file.data();
+		if (!valid_offsets_(reinterpret_cast<const size_type *>(base + layout.first_child), header.node_count)) invalid_(path);
+		view_type view{
+			reinterpret_cast<const CharT *>(base + layout.labels),
+			reinterpret_cast<const size_type *>(base + layout.first_child),
+			reinterpret_cast<const std::uint64_t *>(base + layout.marks),
+			header.node_count };
+		return mapped_trie{ std::move(file), view, static_cast<size_t>(header.size) };
+	}
+
+	size_type find_prefix(string_view s, bool closest_match = false) const {
+		return view_.find_prefix(s, closest_match);
+	}
+
+	bool contains(string_view s) const {
+		return view_.contains(s);
+	}
+
+	std::vector<string> complete_suggestions(string_view s) const {
+		return view_.complete_suggestions(s);
+	}
+
+	std::vector<string> closest_matches(string_view s, unsigned changes = 1, bool transpositions = false) const {
+		return view_.closest_matches(s, changes, transpositions);
+	}
+
+	size_t size() const {
+		return size_;
+	}
+
+	size_type node_count() const {
+		return view_.node_count();
+	}
+
+	view_type view() const {
+		return view_;
+	}
+
+private:
+	mapped_trie(impl_::file_mapping file, view_type view, size_t size) :
+		file_(std::move(file)), view_(view), size_(size)
+	{}
+
+	// The breadth-first layout: children start right after the root and
+	// always come after their parent, ranges never go back, and the last one
+	// ends at the node count. This keeps every child index in bounds and the
+	// walks free of cycles.
+	static bool valid_offsets_(const size_type *first_child, size_type node_count) {
+		if (first_child[0] != 1 || first_child[node_count] != node_count) return false;
+		for (size_type n = 0; n < node_count; ++n) {
+			if (first_child[n] <= n || first_child[n + 1] < first_child[n]) return false;
+		}
+		return true;
+	}
+
+	[[noreturn]] static void invalid_(const std::string &path) {
+		throw std::runtime_error("mapped_trie: not a trie file: " + path);
+	}
+
+	impl_::file_mapping file_;
+	view_type view_;
+	size_t size_;
+};
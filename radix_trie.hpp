@@ -0,0 +1,246 @@
+#pragma once
+
+#include "trie.hpp"
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <algorithm>
+
+namespace impl_
+{
+// A radix node owns the whole run of characters on the edge leading to it,
+// instead of a single one. Children are still kept in the usual Storage and
+// Accessor policies, keyed by the first character of their fragment.
+template <
+	class CharT,
+	class Traits,
+	template <class, class, class> class Storage = impl_::default_vector_storage,
+	template <class> class Accessor = impl_::default_vector_accessor>
+class radix_node_t : public
+	Accessor<Storage<radix_node_t<CharT, Traits, Storage, Accessor>, CharT, Traits>>
+{
+	using AccessorT_ = Accessor<Storage<radix_node_t, CharT, Traits>>;
+
+public:
+	using value_type = CharT;
+	using traits_type = Traits;
+	using string = std::basic_string<CharT, Traits>;
+	using string_view = std::basic_string_view<CharT, Traits>;
+
+	radix_node_t(CharT, string_view fragment, bool marked = false) :
+		fragment_(fragment), marked_(marked)
+	{}
+
+	radix_node_t *emplace_child(string_view fragment, bool marked = false) {
+		return mut_ptr_cast_(std::addressof(*this->AccessorT_::emplace(fragment[0], fragment, marked)));
+	}
+
+	// Cuts the edge after len characters. This node keeps the head of the
+	// fragment, and a single new child takes over the tail, the mark and all
+	// of the current children.
+	void split(size_t len) {
+		radix_node_t tail{ fragment_[len], string_view{} };
+		this->swap_children(tail);
+		radix_node_t *child = emplace_child(string_view{ fragment_ }.substr(len), marked_);
+		child->swap_children(tail);
+		fragment_.resize(len);
+		marked_ = false;
+	}
+
+	void mark() {
+		marked_ = true;
+	}
+
+	void unmark() {
+		marked_ = false;
+	}
+
+	bool marked() const {
+		return marked_;
+	}
+
+	bool leaf() const {
+		return this->raw_storage().empty();
+	}
+
+	CharT value() const {
+		return fragment_.empty() ? CharT{} : fragment_[0];
+	}
+
+	string_view fragment() const {
+		return fragment_;
+	}
+
+	radix_node_t *get_child(CharT ch) {
+		auto it = this->AccessorT_::get(ch);
+		if (it == this->end()) return nullptr;
+		return mut_ptr_cast_(std::addressof(*it));
+	}
+
+	const radix_node_t *get_child(CharT ch) const {
+		return const_cast<radix_node_t *>(this)->get_child(ch);
+	}
+
+	radix_node_t *mut_ptr_cast_(const radix_node_t *node) {
+		return const_cast<radix_node_t *>(node);
+	}
+
+private:
+	string fragment_;
+	bool marked_;
+};
+} // namespace impl_
+
+/*****************************************************************************/
+
+// Path-compressed trie: chains of single-child nodes collapse into one node
+// holding the whole fragment, and lookups compare fragments in one go.
+template <
+	class CharT = char,
+	class Traits = std::char_traits<CharT>,
+	template <class, class, class> class Storage = impl_::default_vector_storage,
+	template <class> class Accessor = impl_::default_vector_accessor>
+class radix_trie
+{
+public:
+	using node = impl_::radix_node_t<CharT, Traits, Storage, Accessor>;
+
+	using string = std::basic_string<CharT, Traits>;
+	using string_view = std::basic_string_view<CharT, Traits>;
+
+	void add(string_view s) {
+		node *current = &root_;
+		size_t j = 0;
+		while (j < s.length()) {
+			node *child = current->get_child(s[j]);
+			if (!child) {
+				current->emplace_child(s.substr(j), true);
+				++size_;
+				return;
+			}
+
+			size_t common = common_prefix_(child->fragment(), s.substr(j));
+			if (common < child->fragment().size()) child->split(common);
+			current = child;
+			j += common;
+		}
+		if (!current->marked()) {
+			++size_;
+			current->mark();
+		}
+	}
+
+	// Returns the node whose edge contains the last character of s, or
+	// nullptr if no key starts with s.
+	const node *find_prefix(string_view s) const {
+		position pos = descend_(s);
+		return pos.matched == s.length() ? pos.n : nullptr;
+	}
+
+	bool contains(string_view s) const {
+		position pos = descend_(s);
+		return pos.matched == s.length() && pos.edge == pos.n->fragment().size() && pos.n->marked();
+	}
+
+	std::vector<string> complete_suggestions(string_view s) const {
+		position pos = descend_(s);
+		if (pos.matched != s.length()) return{};
+
+		string curr{ s };
+		curr += pos.n->fragment().substr(pos.edge);
+
+		std::vector<string> results;
+		if (pos.n->marked()) results.push_back(curr);
+		suggestions_impl(*pos.n, curr, results);
+		return results;
+	}
+
+	// Same semantics as trie::closest_matches.
+	std::vector<string> closest_matches(string_view s, unsigned changes = 1, bool transpositions = false) const {
+		std::vector<string> results;
+		impl_::edit_distance_rows<CharT, Traits> rows{ s, changes, transpositions };
+		closest_impl(root_, rows, changes, results);
+		return results;
+	}
+
+	size_t size() const {
+		return size_;
+	}
+
+	size_t node_count() const {
+		return count_impl(root_);
+	}
+
+private:
+	struct position
+	{
+		const node *n;
+		// Characters of the key matched so far.
+		size_t matched;
+		// Characters of n's fragment matched so far.
+		size_t edge;
+	};
+
+	static size_t common_prefix_(string_view fragment, string_view s) {
+		size_t len = std::min(fragment.size(), s.size());
+		// Whole-fragment comparison first; the common case on lookups.
+		if (Traits::compare(fragment.data(), s.data(), len) == 0) return len;
+		return std::mismatch(fragment.begin(), fragment.begin() + len, s.begin(), [](CharT lhs, CharT rhs) {
+			return Traits::eq(lhs, rhs);
+		}).first - fragment.begin();
+	}
+
+	position descend_(string_view s) const {
+		const node *current = &root_;
+		size_t j = 0;
+		while (j < s.length()) {
+			const node *child = current->get_child(s[j]);
+			if (!child) break;
+
+			size_t common = common_prefix_(child->fragment(), s.substr(j));
+			j += common;
+			if (common < child->fragment().size()) return { child, j, common };
+			current = child;
+		}
+		return { current, j, current->fragment().size() };
+	}
+
+	void suggestions_impl(const node &n, string &curr, std::vector<string> &results) const {
+		for (const node &child : n.get_elements()) {
+			curr += child.fragment();
+			if (child.marked()) results.push_back(curr);
+			if (!child.leaf()) suggestions_impl(child, curr, results);
+			curr.resize(curr.size() - child.fragment().size());
+		}
+	}
+
+	// A fragment is matched one character at a time, so the walk can leave
+	// an edge halfway through.
+	void closest_impl(const node &n, impl_::edit_distance_rows<CharT, Traits> &rows, unsigned changes, std::vector<string> &results) const {
+		for (const node &child : n.get_elements()) {
+			string_view fragment = child.fragment();
+			size_t pushed = 0;
+			unsigned row_min = 0;
+			while (pushed < fragment.size() && row_min <= changes) {
+				row_min = rows.push(fragment[pushed++]);
+			}
+			if (pushed == fragment.size()) {
+				if (child.marked() && rows.distance() <= changes) results.push_back(rows.candidate());
+				if (row_min <= changes && !child.leaf()) closest_impl(child, rows, changes, results);
+			}
+			while (pushed-- > 0) rows.pop();
+		}
+	}
+
+	size_t count_impl(const node &n) const {
+		size_t count = 1;
+		for (const node &child : n.get_elements()) {
+			count += count_impl(child);
+		}
+		return count;
+	}
+
+	node root_{ CharT{}, string_view{} };
+	size_t size_{ 0 };
+};
@@ -0,0 +1,233 @@
+#pragma once
+
+#include "trie.hpp"
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <algorithm>
+#include <queue>
+#include <optional>
+#include <utility>
+#include <cstdint>
+
+namespace impl_
+{
+// Node of a scored_trie. Besides the weight of its own key, every node caches
+// the largest weight found in its subtrie, which bounds anything a search
+// can still find below it.
+template <
+	class CharT,
+	class Traits,
+	class Weight,
+	template <class, class, class> class Storage = impl_::default_vector_storage,
+	template <class> class Accessor = impl_::default_vector_accessor>
+class scored_node_t : public
+	Accessor<Storage<scored_node_t<CharT, Traits, Weight, Storage, Accessor>, CharT, Traits>>
+{
+	using AccessorT_ = Accessor<Storage<scored_node_t, CharT, Traits>>;
+
+public:
+	using value_type = CharT;
+	using traits_type = Traits;
+	using weight_type = Weight;
+
+	explicit scored_node_t(CharT ch) : value_(ch) {}
+
+	scored_node_t *get_or_emplace(CharT ch) {
+		return mut_ptr_cast_(std::addressof(*this->AccessorT_::get_or_emplace(ch, ch)));
+	}
+
+	scored_node_t *get_child(CharT ch) {
+		auto it = this->AccessorT_::get(ch);
+		if (it == this->end()) return nullptr;
+		return mut_ptr_cast_(std::addressof(*it));
+	}
+
+	const scored_node_t *get_child(CharT ch) const {
+		return const_cast<scored_node_t *>(this)->get_child(ch);
+	}
+
+	CharT value() const {
+		return value_;
+	}
+
+	bool marked() const {
+		return marked_;
+	}
+
+	Weight weight() const {
+		return weight_;
+	}
+
+	Weight max_weight() const {
+		return max_weight_;
+	}
+
+	void set_weight(Weight w) {
+		marked_ = true;
+		weight_ = w;
+	}
+
+	void raise_max_weight(Weight w) {
+		max_weight_ = std::max(max_weight_, w);
+	}
+
+	// Recomputes the cached maximum from the node's own key and children.
+	void refresh_max_weight() {
+		max_weight_ = marked_ ? weight_ : Weight{};
+		for (const scored_node_t &child : this->get_elements()) {
+			max_weight_ = std::max(max_weight_, child.max_weight_);
+		}
+	}
+
+	scored_node_t *mut_ptr_cast_(const scored_node_t *node) {
+		return const_cast<scored_node_t *>(node);
+	}
+
+private:
+	Weight weight_{};
+	Weight max_weight_{};
+	CharT value_;
+	bool marked_ = false;
+};
+} // namespace impl_
+
+/*****************************************************************************/
+
+// Trie whose keys carry a weight, answering "the k heaviest keys starting
+// with this prefix" without enumerating the others.
+template <
+	class CharT = char,
+	class Weight = std::uint32_t,
+	class Traits = std::char_traits<CharT>,
+	template <class, class, class> class Storage = impl_::default_vector_storage,
+	template <class> class Accessor = impl_::default_vector_accessor>
+class scored_trie
+{
+public:
+	using node = impl_::scored_node_t<CharT, Traits, Weight, Storage, Accessor>;
+
+	using string = std::basic_string<CharT, Traits>;
+	using string_view = std::basic_string_view<CharT, Traits>;
+	using weight_type = Weight;
+
+	// Adds s with the given weight, or replaces the weight if s is present.
+	void add(string_view s, Weight weight) {
+		path_.clear();
+		node *current = &root_;
+		path_.push_back(current);
+		for (size_t j = 0, len = s.length(); j < len; ++j) {
+			current = current->get_or_emplace(s[j]);
+			path_.push_back(current);
+		}
+
+		bool lowered = current->marked() && weight < current->weight();
+		if (!current->marked()) ++size_;
+		current->set_weight(weight);
+
+		if (!lowered) {
+			for (node *n : path_) n->raise_max_weight(weight);
+			return;
+		}
+		// The old weight may have been the maximum of every node on the path.
+		for (auto it = path_.rbegin(); it != path_.rend(); ++it) {
+			(*it)->refresh_max_weight();
+		}
+	}
+
+	bool contains(string_view s) const {
+		const node *n = find_prefix(s);
+		return n && n->marked();
+	}
+
+	std::optional<Weight> weight(string_view s) const {
+		const node *n = find_prefix(s);
+		if (!n || !n->marked()) return std::nullopt;
+		return n->weight();
+	}
+
+	const node *find_prefix(string_view s) const {
+		const node *current = &root_;
+		for (size_t j = 0, len = s.length(); current && j < len; ++j) {
+			current = current->get_child(s[j]);
+		}
+		return current;
+	}
+
+	// The k heaviest keys starting with s, heaviest first; ties in the order
+	// they are reached. The search always expands the most promising subtrie
+	// next, and stops as soon as k keys have come out ahead of every
+	// unexplored branch.
+	std::vector<std::pair<string, Weight>> top_k_completions(string_view s, size_t k) const {
+		std::vector<std::pair<string, Weight>> results;
+		const node *start = find_prefix(s);
+		if (!start || k == 0) return results;
+
+		// Keys are spelled out only once they are returned: each candidate
+		// refers to its parent's entry in this trail.
+		struct step
+		{
+			size_t parent;
+			CharT value;
+		};
+		std::vector<step> trail;
+
+		struct candidate
+		{
+			Weight bound;
+			// Set for a key whose weight is exact, unset for a subtrie.
+			bool exact;
+			size_t order;
+			const node *n;
+			size_t trail_pos;
+
+			bool operator<(const candidate &rhs) const {
+				if (bound != rhs.bound) return bound < rhs.bound;
+				if (exact != rhs.exact) return !exact;
+				return order > rhs.order;
+			}
+		};
+
+		const size_t root_pos = static_cast<size_t>(-1);
+		size_t order = 0;
+		std::priority_queue<candidate> queue;
+		queue.push({ start->max_weight(), false, order++, start, root_pos });
+		while (!queue.empty() && results.size() < k) {
+			candidate c = queue.top();
+			queue.pop();
+
+			if (c.exact) {
+				results.emplace_back(spell_(s, trail, c.trail_pos), c.bound);
+				continue;
+			}
+			if (c.n->marked()) queue.push({ c.n->weight(), true, order++, c.n, c.trail_pos });
+			for (const node &child : c.n->get_elements()) {
+				trail.push_back({ c.trail_pos, child.value() });
+				queue.push({ child.max_weight(), false, order++, &child, trail.size() - 1 });
+			}
+		}
+		return results;
+	}
+
+	size_t size() const {
+		return size_;
+	}
+
+private:
+	template <class Trail>
+	static string spell_(string_view prefix, const Trail &trail, size_t pos) {
+		string suffix;
+		for (; pos != static_cast<size_t>(-1); pos = trail[pos].parent) {
+			suffix.push_back(trail[pos].value);
+		}
+		string result{ prefix };
+		result.append(suffix.rbegin(), suffix.rend());
+		return result;
+	}
+
+	node root_{ CharT{} };
+	size_t size_{ 0 };
+	// Scratch space for add, kept to avoid reallocating on every call.
+	std::vector<node *> path_;
+};
@@ -0,0 +1,192 @@
+#pragma once
+
+#include "frozen_trie.hpp"
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <iterator>
+#include <type_traits>
+#include <cstdint>
+
+namespace impl_
+{
+// Character type of a key table, taken from its first entry: a string
+// literal, a character pointer or a string_view all do.
+template <class Key>
+using key_char_t = typename decltype(std::basic_string_view{ std::declval<const Key &>() })::value_type;
+
+// Number of distinct prefixes, the empty one included, of keys that are
+// sorted: every key adds the characters past its common prefix with the key
+// before it.
+template <class StringView, size_t KeyCount>
+constexpr size_t sorted_prefix_count(const StringView (&keys)[KeyCount]) {
+	size_t count = 1;
+	for (size_t j = 0; j < KeyCount; ++j) {
+		size_t common = 0;
+		if (j > 0) {
+			while (common < keys[j - 1].size() && common < keys[j].size() &&
+				StringView::traits_type::eq(keys[j - 1][common], keys[j][common])) {
+				++common;
+			}
+		}
+		count += keys[j].size() - common;
+	}
+	return count;
+}
+
+// The keys of a table as string_views, sorted. std::sort is not constexpr
+// yet, and keyword tables are small, so this is an insertion sort.
+template <class CharT, class Traits, size_t KeyCount>
+struct sorted_keys
+{
+	using string_view = std::basic_string_view<CharT, Traits>;
+
+	template <class Keys>
+	constexpr explicit sorted_keys(const Keys &keys) {
+		for (size_t j = 0; j < KeyCount; ++j) {
+			string_view key{ keys[j] };
+			size_t pos = j;
+			for (; pos > 0 && key.compare(values[pos - 1]) < 0; --pos) {
+				values[pos] = values[pos - 1];
+			}
+			values[pos] = key;
+		}
+	}
+
+	string_view values[KeyCount] = {};
+};
+} // namespace impl_
+
+/*****************************************************************************/
+
+// Trie over a key table known at compile time, built by the compiler. It
+// uses the breadth-first layout of frozen_trie, held in fixed-size arrays, so
+// it needs no heap and no startup work, and find_prefix and contains can run
+// in constant expressions. Children are scanned linearly, which for the
+// fan-outs of keyword tables beats a binary search. Build one with
+// make_static_trie.
+template <class CharT, size_t NodeCount, class Traits = std::char_traits<CharT>>
+class static_trie
+{
+	using view_type = impl_::flat_trie_view<CharT, Traits>;
+public:
+	using size_type = typename view_type::size_type;
+	using string = std::basic_string<CharT, Traits>;
+	using string_view = std::basic_string_view<CharT, Traits>;
+
+	static constexpr size_type npos = view_type::npos;
+	static constexpr size_type root = view_type::root;
+
+	// keys must be sorted, and hold exactly NodeCount distinct prefixes.
+	template <size_t KeyCount>
+	constexpr explicit static_trie(const string_view (&keys)[KeyCount]) {
+		// A node is the prefix of length depth[n] of keys[first_key[n]], the
+		// first key that starts with it.
+		size_type first_key[NodeCount] = {};
+		size_type depth[NodeCount] = {};
+		size_type count = 1;
+		for (size_type n = 0; n < NodeCount; ++n) {
+			first_child_[n] = count;
+			size_t j = first_key[n];
+			if (j < KeyCount && keys[j].size() == depth[n]) {
+				marks_[n / 64] |= std::uint64_t{ 1 } << (n % 64);
+				++size_;
+			}
+			for (; j < KeyCount && has_prefix_(keys[j], keys[first_key[n]], depth[n]); ++j) {
+				if (keys[j].size() == depth[n]) continue;
+				CharT c = keys[j][depth[n]];
+				if (count > first_child_[n] && Traits::eq(labels_[count - 1], c)) continue;
+				labels_[count] = c;
+				first_key[count] = static_cast<size_type>(j);
+				depth[count] = depth[n] + 1;
+				++count;
+			}
+		}
+		first_child_[NodeCount] = count;
+	}
+
+	constexpr size_type node_count() const {
+		return NodeCount;
+	}
+
+	constexpr CharT value(size_type n) const {
+		return labels_[n];
+	}
+
+	constexpr bool marked(size_type n) const {
+		return (marks_[n / 64] >> (n % 64)) & 1;
+	}
+
+	constexpr bool leaf(size_type n) const {
+		return first_child_[n] == first_child_[n + 1];
+	}
+
+	constexpr size_type get_child(size_type n, CharT ch) const {
+		for (size_type child = first_child_[n], last = first_child_[n + 1]; child != last; ++child) {
+			if (Traits::eq(labels_[child], ch)) return child;
+			if (Traits::lt(ch, labels_[child])) break;
+		}
+		return npos;
+	}
+
+	// Same semantics as frozen_trie::find_prefix.
+	constexpr size_type find_prefix(string_view s, bool closest_match = false) const {
+		size_type current = root;
+		for (size_t j = 0, len = s.length(); j < len; ++j) {
+			size_type next = get_child(current, s[j]);
+			if (next == npos) return closest_match ? current : npos;
+			current = next;
+		}
+		return current;
+	}
+
+	constexpr bool contains(string_view s) const {
+		size_type n = find_prefix(s);
+		return n != npos && marked(n);
+	}
+
+	std::vector<string> complete_suggestions(string_view s) const {
+		return view().complete_suggestions(s);
+	}
+
+	std::vector<string> closest_matches(string_view s, unsigned changes = 1, bool transpositions = false) const {
+		return view().closest_matches(s, changes, transpositions);
+	}
+
+	constexpr size_t size() const {
+		return size_;
+	}
+
+	view_type view() const {
+		return { labels_, first_child_, marks_, NodeCount };
+	}
+
+private:
+	static constexpr bool has_prefix_(string_view s, string_view prefix, size_t len) {
+		return s.size() >= len && s.substr(0, len) == prefix.substr(0, len);
+	}
+
+	CharT labels_[NodeCount] = {};
+	size_type first_child_[NodeCount + 1] = {};
+	std::uint64_t marks_[(NodeCount + 63) / 64] = {};
+	size_t size_ = 0;
+};
+
+// Builds the static_trie of a key table with static storage duration: an
+// array of string literals, character pointers or string_views, in any order
+// and possibly with duplicates.
+//
+//     static constexpr const char *methods[] = { "GET", "HEAD", "POST" };
+//     constexpr auto http_methods = make_static_trie<methods>();
+//     static_assert(http_methods.contains("HEAD"));
+template <
+	const auto &Keys,
+	class CharT = impl_::key_char_t<std::decay_t<decltype(Keys[0])>>,
+	class Traits = std::char_traits<CharT>>
+constexpr auto make_static_trie() {
+	constexpr size_t key_count = std::size(Keys);
+	constexpr impl_::sorted_keys<CharT, Traits, key_count> sorted{ Keys };
+	constexpr size_t node_count = impl_::sorted_prefix_count(sorted.values);
+	return static_trie<CharT, node_count, Traits>{ sorted.values };
+}
@@ -1,179 +1,877 @@
-#include <benchmark\benchmark.h>
+#include <benchmark/benchmark.h>
 #include "../trie.hpp"
-#include "../trie_vec.hpp"
+#include "../frozen_trie.hpp"
+#include "../mapped_trie.hpp"
+#include "../radix_trie.hpp"
+#include "../concurrent_trie.hpp"
+#include "../scored_trie.hpp"
+#include "../trie_map.hpp"
+#include "../static_trie.hpp"
+#include "../aho_corasick.hpp"
+#include "../utf8_trie.hpp"
+#include "../dawg.hpp"
+#include <cstdlib>
+#include <cstdio>
 #include <iostream>
 #include <random>
 #include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
 #include <new>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
 #include "comparison.h"
 
-std::random_device rd;
-std::uniform_int_distribution<int> dist('A', '}');
+#if defined(__GLIBC__)
+#include <malloc.h>
+#define BENCH_TRACK_HEAP 1
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+// Benchmarks of every trie flavour over generated corpora that look like real
+// keys: English-like words, which share prefixes and suffixes the way a
+// dictionary does, and URL paths, with long shared prefixes and numeric ids.
+// Lookups follow a Zipf distribution over the keys, as query logs do.
+//
+// Besides time per operation, every benchmark that builds a trie reports:
+//   bytes_per_key  heap bytes held by the trie divided by its key count,
+//                  allocator slack included (glibc only);
+//   peak_rss_mb    peak resident set of the process so far. It only ever
+//                  grows, so run one benchmark per process, for instance
+//                  with --benchmark_filter, to compare policies with it.
 
 template <class ValueT, size_t MaxLen = 255U, class Traits = std::char_traits<ValueT>>
 using vec_trie = trie<ValueT, MaxLen, Traits, impl_::default_vector_storage, impl_::default_vector_accessor>;
 
-
 template <class ValueT,size_t MaxLen = 255U, class Traits = std::char_traits<ValueT>>
 using set_trie = trie<ValueT, MaxLen, Traits, impl_::default_set_storage, impl_::default_set_storage_accessor>;
 
-#ifdef _MSC_VER 
-#pragma comment(lib, "Shlwapi.lib")
+template <class ValueT, size_t MaxLen = 255U, class Traits = std::char_traits<ValueT>>
+using arena_trie = trie<ValueT, MaxLen, Traits, impl_::arena_vector_storage, impl_::default_vector_accessor>;
+
+template <class ValueT, size_t MaxLen = 255U, class Traits = std::char_traits<ValueT>>
+using adaptive_trie = trie<ValueT, MaxLen, Traits, impl_::adaptive_storage, impl_::adaptive_accessor>;
+
+template <class ValueT, size_t MaxLen = 255U, class Traits = std::char_traits<ValueT>>
+using simd_trie = trie<ValueT, MaxLen, Traits, impl_::split_vector_storage, impl_::simd_vector_accessor>;
+
+template <class ValueT, size_t MaxLen = 255U, class Traits = std::char_traits<ValueT>>
+using unordered_trie = trie<ValueT, MaxLen, Traits, impl_::default_vector_storage, impl_::unordered_vector_accessor>;
+
+// Words only: the other corpora have symbols outside the host name alphabet.
+using bitmap_trie = trie<char, 255U, impl_::alphabet_traits<impl_::hostname_alphabet>, impl_::bitmap_storage, impl_::bitmap_accessor>;
+
+template <class ValueT, class Traits = std::char_traits<ValueT>>
+using compact_vec_trie = compact_trie<ValueT, Traits, impl_::default_vector_storage, impl_::default_vector_accessor>;
+
+/*****************************************************************************/
+// Memory metrics
+
+#ifdef BENCH_TRACK_HEAP
+static std::atomic<size_t> heap_live_bytes{ 0 };
+
+void *operator new(size_t size) {
+	void *p = std::malloc(size ? size : 1);
+	if (!p) throw std::bad_alloc{};
+	heap_live_bytes.fetch_add(malloc_usable_size(p), std::memory_order_relaxed);
+	return p;
+}
+
+void operator delete(void *p) noexcept {
+	if (!p) return;
+	heap_live_bytes.fetch_sub(malloc_usable_size(p), std::memory_order_relaxed);
+	std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+	operator delete(p);
+}
 #endif
 
-std::vector<std::string> generate_random_words(int count, int len) {
-	std::string s(len, 'a');
-	std::vector<std::string> res;
-	res.reserve(count);
+// Heap bytes allocated and not yet freed since construction.
+class heap_meter
+{
+public:
+	size_t read() const {
+		return live_() - start_;
+	}
 
-	for (int j = 0; j < count; ++j) {
-		std::mt19937 rnd(rd());
-		std::generate(s.begin(), s.end(), [&] { return dist(rnd); });
-		res.push_back(s);
+private:
+	static size_t live_() {
+#ifdef BENCH_TRACK_HEAP
+		return heap_live_bytes.load(std::memory_order_relaxed);
+#else
+		return 0;
+#endif
 	}
-	return res;
+
+	size_t start_ = live_();
+};
+
+static double peak_rss_mb() {
+#if defined(__unix__) || defined(__APPLE__)
+	rusage usage{};
+	getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+	return usage.ru_maxrss / (1024.0 * 1024.0);
+#else
+	return usage.ru_maxrss / 1024.0;
+#endif
+#else
+	return 0;
+#endif
 }
 
-static void BM_SetTrieAdd255(benchmark::State& state) {
-	
-	while (state.KeepRunning()) {
-		state.PauseTiming();
-		set_trie<char, 255U> t;
-		auto vec = generate_random_words(state.range(0), state.range(1));
-		state.ResumeTiming();
-		for (const auto & s : vec)
-			t.add(s);
+static void set_memory_counters(benchmark::State& state, size_t bytes, size_t keys) {
+#ifdef BENCH_TRACK_HEAP
+	state.counters["bytes_per_key"] = keys ? static_cast<double>(bytes) / keys : 0;
+#endif
+	state.counters["peak_rss_mb"] = peak_rss_mb();
+}
+
+/*****************************************************************************/
+// Corpora
+
+enum class corpus { words, urls };
+
+// Picks an index in [0, n) with probability proportional to 1 / (index + 1):
+// the first entries of a table are the common ones.
+static size_t skewed_pick(std::mt19937 &rnd, size_t n) {
+	static std::map<size_t, std::discrete_distribution<size_t>> distributions;
+	auto it = distributions.find(n);
+	if (it == distributions.end()) {
+		std::vector<double> weights(n);
+		for (size_t j = 0; j < n; ++j) {
+			weights[j] = 1.0 / (j + 1);
+		}
+		it = distributions.emplace(n, std::discrete_distribution<size_t>{ weights.begin(), weights.end() }).first;
 	}
+	return it->second(rnd);
+}
 
-	state.SetItemsProcessed(state.iterations() * state.range(0));
+template <size_t N>
+static const char *skewed_pick(std::mt19937 &rnd, const char *const (&table)[N]) {
+	return table[skewed_pick(rnd, N)];
 }
 
-static void BM_VecTrieAdd255(benchmark::State& state) {
+// Words made of syllables with common onsets, vowels and codas, and common
+// English prefixes and suffixes, so that many of them share stems.
+static std::string english_word(std::mt19937 &rnd) {
+	static const char *const onsets[] = {
+		"s", "t", "", "c", "b", "p", "m", "d", "r", "l", "f", "h", "g", "st", "tr", "pr", "br", "ch",
+		"w", "n", "sh", "th", "cr", "gr", "fl", "sp", "cl", "bl", "v", "dr", "pl", "j", "k", "qu", "str", "z"
+	};
+	static const char *const vowels[] = { "a", "e", "i", "o", "u", "ea", "ou", "ai", "ee", "oo", "ie", "y" };
+	static const char *const codas[] = {
+		"", "n", "r", "t", "s", "l", "nd", "st", "ck", "m", "ng", "d", "nt", "p", "ll", "rt", "ss", "x", "ft"
+	};
+	static const char *const prefixes[] = { "re", "un", "in", "dis", "pre", "over", "sub", "inter" };
+	static const char *const suffixes[] = { "s", "ed", "ing", "er", "ly", "ion", "able", "ness", "ment", "ful" };
 
-	while (state.KeepRunning()) {
-		state.PauseTiming();
-		vec_trie<char, 255U> t;
-		auto vec = generate_random_words(state.range(0), state.range(1));
-		state.ResumeTiming();
-		for (const auto & s : vec)
-			t.add(s);
+	std::string word;
+	if (rnd() % 8 == 0) word += skewed_pick(rnd, prefixes);
+	size_t syllables = 1 + skewed_pick(rnd, 4);
+	for (size_t j = 0; j < syllables; ++j) {
+		word += skewed_pick(rnd, onsets);
+		word += skewed_pick(rnd, vowels);
+		word += skewed_pick(rnd, codas);
 	}
+	if (rnd() % 5 < 2) word += skewed_pick(rnd, suffixes);
+	return word;
+}
 
-	state.SetItemsProcessed(state.iterations() * state.range(0));
+// REST-style paths: a few services and resources account for most of them,
+// and many end in numeric ids.
+static std::string url_path(std::mt19937 &rnd) {
+	static const char *const services[] = { "api", "static", "shop", "admin", "auth", "search", "blog", "docs", "media", "cdn" };
+	static const char *const versions[] = { "v2", "v1", "v3" };
+	static const char *const resources[] = {
+		"users", "products", "orders", "sessions", "images", "carts", "reviews", "payments", "categories",
+		"invoices", "comments", "posts", "tags", "settings", "reports", "inventory", "shipments", "coupons"
+	};
+	static const char *const actions[] = { "", "details", "history", "items", "preview", "status", "export" };
+
+	std::string path = "/";
+	path += skewed_pick(rnd, services);
+	path += '/';
+	path += skewed_pick(rnd, versions);
+	path += '/';
+	path += skewed_pick(rnd, resources);
+	if (rnd() % 4 != 0) {
+		path += '/';
+		path += std::to_string(std::uniform_int_distribution<unsigned>{ 1, 999999 }(rnd));
+		std::string action = skewed_pick(rnd, actions);
+		if (!action.empty()) path += '/' + action;
+	}
+	return path;
 }
 
+// count distinct keys of a corpus, in random order. Keys come from a fixed
+// seed, and a bigger corpus starts with the keys of any smaller one.
+static const std::vector<std::string> &corpus_keys(corpus c, size_t count) {
+	static std::map<std::pair<corpus, size_t>, std::vector<std::string>> cache;
+	auto &keys = cache[{ c, count }];
+	if (!keys.empty()) return keys;
 
-static void BM_SetTrieAdd512(benchmark::State& state) {
-	while (state.KeepRunning()) {
-		state.PauseTiming();
-		set_trie<char, 512U> t;
-		auto vec = generate_random_words(state.range(0), state.range(1));
-		state.ResumeTiming();
-		for (const auto & s : vec)
-			t.add(s);
+	std::mt19937 rnd{ 20181 };
+	std::unordered_set<std::string> seen;
+	keys.reserve(count);
+	while (keys.size() < count) {
+		std::string key = c == corpus::words ? english_word(rnd) : url_path(rnd);
+		if (seen.insert(key).second) keys.push_back(std::move(key));
 	}
+	return keys;
+}
 
-	state.SetItemsProcessed(state.iterations() * state.range(0));
+static const size_t query_count = 1 << 16;
+
+// Keys of a corpus drawn with Zipf's law (probability proportional to
+// 1 / rank). Ranks are dealt out at random, so popular keys are spread all
+// over the trie.
+static const std::vector<std::string_view> &zipf_queries(corpus c, size_t count) {
+	static std::map<std::pair<corpus, size_t>, std::vector<std::string_view>> cache;
+	auto &queries = cache[{ c, count }];
+	if (!queries.empty()) return queries;
+
+	const auto &keys = corpus_keys(c, count);
+	std::mt19937 rnd{ 1999 };
+	std::vector<size_t> rank_to_key(keys.size());
+	for (size_t j = 0; j < rank_to_key.size(); ++j) {
+		rank_to_key[j] = j;
+	}
+	std::shuffle(rank_to_key.begin(), rank_to_key.end(), rnd);
+
+	std::vector<double> weights(keys.size());
+	for (size_t j = 0; j < weights.size(); ++j) {
+		weights[j] = 1.0 / (j + 1);
+	}
+	std::discrete_distribution<size_t> rank{ weights.begin(), weights.end() };
+	queries.reserve(query_count);
+	for (size_t j = 0; j < query_count; ++j) {
+		queries.push_back(keys[rank_to_key[rank(rnd)]]);
+	}
+	return queries;
+}
+
+// Uniformly random strings over a wide alphabet: the worst case for sharing.
+static std::vector<std::string> generate_random_words(size_t count, size_t len) {
+	static std::mt19937 rnd{ 7 };
+	std::uniform_int_distribution<int> dist('A', '}');
+	std::vector<std::string> res(count, std::string(len, 'a'));
+	for (auto &s : res) {
+		std::generate(s.begin(), s.end(), [&] { return static_cast<char>(dist(rnd)); });
+	}
+	return res;
+}
+
+// A key as Trie takes it: tries over an alphabet_traits use their own
+// string_view type.
+template <class Trie>
+static typename Trie::string_view key_of(std::string_view s) {
+	return { s.data(), s.size() };
 }
 
-static void BM_TrieAddComp(benchmark::State& state) {
-	while (state.KeepRunning()) {
+template <class Trie>
+static void add_all(Trie &t, const std::vector<std::string> &keys) {
+	for (const auto &key : keys) {
+		t.add(key_of<Trie>(key));
+	}
+}
+
+static void corpus_sizes(benchmark::internal::Benchmark *b) {
+	b->RangeMultiplier(8)->Range(1 << 12, 1 << 18);
+}
+
+/*****************************************************************************/
+// Workloads, for every Storage/Accessor policy
+
+template <class Trie, corpus C>
+static void BM_Add(benchmark::State& state) {
+	const auto &keys = corpus_keys(C, state.range(0));
+	size_t bytes = 0;
+	for (auto _ : state) {
+		heap_meter meter;
+		auto t = std::make_unique<Trie>();
+		add_all(*t, keys);
 		state.PauseTiming();
-		Trie t;
-		auto words = generate_random_words(state.range(0), state.range(1));
+		bytes = meter.read();
+		t.reset();
 		state.ResumeTiming();
-		t.build_trie(words.data(), words.size());
 	}
+	state.SetItemsProcessed(state.iterations() * keys.size());
+	set_memory_counters(state, bytes, keys.size());
+}
+
+template <class Trie, corpus C>
+static void BM_Find(benchmark::State& state) {
+	const auto &keys = corpus_keys(C, state.range(0));
+	heap_meter meter;
+	Trie t;
+	add_all(t, keys);
+	size_t bytes = meter.read();
+	const auto &queries = zipf_queries(C, state.range(0));
 
-	state.SetItemsProcessed(state.iterations() * state.range(0));
+	size_t j = 0;
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(t.find_prefix(key_of<Trie>(queries[j++ % queries.size()])));
+	}
+	state.SetItemsProcessed(state.iterations());
+	set_memory_counters(state, bytes, keys.size());
 }
 
-#ifdef BENCH_ADD
-BENCHMARK(BM_SetTrieAdd255)->Ranges({ { 64, 4096 }, { 8, 64 } })->Unit(benchmark::kMicrosecond);
-BENCHMARK(BM_VecTrieAdd255)->Ranges({ { 64, 4096 },{ 8, 255 } })->Unit(benchmark::kMicrosecond);
-BENCHMARK(BM_TrieAddComp)->Ranges({ { 1, 4096 },{ 1, 64 } })->Unit(benchmark::kMicrosecond);
-#endif
+// Autocomplete: the first ten keys below the first half of a query.
+template <class Trie, corpus C>
+static void BM_Complete(benchmark::State& state) {
+	const auto &keys = corpus_keys(C, state.range(0));
+	heap_meter meter;
+	Trie t;
+	add_all(t, keys);
+	size_t bytes = meter.read();
+	const auto &queries = zipf_queries(C, state.range(0));
 
-// Define another benchmark
-static void BM_SetTrieFind(benchmark::State& state) {
-	while (state.KeepRunning()) {
-		state.PauseTiming();
-		set_trie<char, 255U> t;
-		auto words = generate_random_words(state.range(0), state.range(1));
-		for (const auto &word : words) {
-			t.add(word);
+	size_t j = 0;
+	for (auto _ : state) {
+		std::string_view query = queries[j++ % queries.size()];
+		int read = 0;
+		for (auto key : t.completions(key_of<Trie>(query.substr(0, query.size() / 2)))) {
+			benchmark::DoNotOptimize(key);
+			if (++read == 10) break;
 		}
-		std::vector<std::string> s;
-		std::sample(words.begin(), words.end(), std::back_inserter(s), state.range(2), std::mt19937{ std::random_device{}() });
-		state.ResumeTiming();
+	}
+	state.SetItemsProcessed(state.iterations());
+	set_memory_counters(state, bytes, keys.size());
+}
+
+// Spell-correct: a query with one character replaced, at one edit.
+template <class Trie, corpus C>
+static void BM_Fuzzy(benchmark::State& state) {
+	const auto &keys = corpus_keys(C, state.range(0));
+	heap_meter meter;
+	Trie t;
+	add_all(t, keys);
+	size_t bytes = meter.read();
 
-		for (const auto &str : s)
-			t.find_prefix(str);
+	std::vector<std::string> typos;
+	for (std::string_view query : zipf_queries(C, state.range(0))) {
+		typos.emplace_back(query);
+		typos.back()[typos.size() % query.size()] = '#';
+		if (typos.size() == 1024) break;
 	}
+
+	size_t j = 0;
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(t.closest_matches(key_of<Trie>(typos[j++ % typos.size()]), 1));
+	}
+	state.SetItemsProcessed(state.iterations());
+	set_memory_counters(state, bytes, keys.size());
 }
 
-static void BM_VecTrieFind(benchmark::State& state) {
-	while (state.KeepRunning()) {
-		state.PauseTiming();
-		vec_trie<char, 255U> t;
-		auto words = generate_random_words(state.range(0), state.range(1));
-		for (const auto &word : words) {
-			t.add(word);
+// Key churn: a random key is removed and added back.
+template <class Trie, corpus C>
+static void BM_RemoveAdd(benchmark::State& state) {
+	const auto &keys = corpus_keys(C, state.range(0));
+	heap_meter meter;
+	Trie t;
+	add_all(t, keys);
+	size_t bytes = meter.read();
+
+	size_t j = 0;
+	for (auto _ : state) {
+		const auto &key = keys[(j++ * 7919) % keys.size()];
+		t.remove(key_of<Trie>(key));
+		t.add(key_of<Trie>(key));
+	}
+	state.SetItemsProcessed(state.iterations());
+	set_memory_counters(state, bytes, keys.size());
+}
+
+// Read-mostly traffic on a trie that holds half of the corpus: 90% lookups
+// with Zipf queries, 8% adds and 2% removals of random keys.
+template <class Trie, corpus C>
+static void BM_Mixed(benchmark::State& state) {
+	const auto &keys = corpus_keys(C, state.range(0));
+	const auto &queries = zipf_queries(C, state.range(0));
+	heap_meter meter;
+	Trie t;
+	for (size_t j = 0; j < keys.size(); j += 2) {
+		t.add(key_of<Trie>(keys[j]));
+	}
+	size_t bytes = meter.read();
+
+	enum op_kind : unsigned char { find, add, remove };
+	struct op
+	{
+		op_kind kind;
+		std::string_view key;
+	};
+	std::vector<op> ops;
+	std::mt19937 rnd{ 5 };
+	for (size_t j = 0; j < query_count; ++j) {
+		unsigned r = rnd() % 100;
+		std::string_view random_key = keys[rnd() % keys.size()];
+		if (r < 90) ops.push_back({ find, queries[j] });
+		else ops.push_back({ r < 98 ? add : remove, random_key });
+	}
+
+	size_t j = 0;
+	for (auto _ : state) {
+		const op &o = ops[j++ % ops.size()];
+		switch (o.kind) {
+		case find: benchmark::DoNotOptimize(t.find_prefix(key_of<Trie>(o.key))); break;
+		case add: t.add(key_of<Trie>(o.key)); break;
+		case remove: t.remove(key_of<Trie>(o.key)); break;
 		}
-		std::vector<std::string> s;
-		std::sample(words.begin(), words.end(), std::back_inserter(s), state.range(2), std::mt19937{ std::random_device{}() });
+	}
+	state.SetItemsProcessed(state.iterations());
+	set_memory_counters(state, bytes, t.size());
+}
+
+#define TRIE_POLICY_BENCHMARKS(Trie, Corpus) \
+	BENCHMARK_TEMPLATE(BM_Add, Trie, Corpus)->Apply(corpus_sizes)->Unit(benchmark::kMillisecond); \
+	BENCHMARK_TEMPLATE(BM_Find, Trie, Corpus)->Apply(corpus_sizes); \
+	BENCHMARK_TEMPLATE(BM_Complete, Trie, Corpus)->Apply(corpus_sizes); \
+	BENCHMARK_TEMPLATE(BM_Fuzzy, Trie, Corpus)->Apply(corpus_sizes)->Unit(benchmark::kMicrosecond); \
+	BENCHMARK_TEMPLATE(BM_RemoveAdd, Trie, Corpus)->Apply(corpus_sizes); \
+	BENCHMARK_TEMPLATE(BM_Mixed, Trie, Corpus)->Apply(corpus_sizes)
+
+TRIE_POLICY_BENCHMARKS(vec_trie<char>, corpus::words);
+TRIE_POLICY_BENCHMARKS(set_trie<char>, corpus::words);
+TRIE_POLICY_BENCHMARKS(arena_trie<char>, corpus::words);
+TRIE_POLICY_BENCHMARKS(adaptive_trie<char>, corpus::words);
+TRIE_POLICY_BENCHMARKS(simd_trie<char>, corpus::words);
+TRIE_POLICY_BENCHMARKS(unordered_trie<char>, corpus::words);
+TRIE_POLICY_BENCHMARKS(compact_vec_trie<char>, corpus::words);
+TRIE_POLICY_BENCHMARKS(bitmap_trie, corpus::words);
+
+TRIE_POLICY_BENCHMARKS(vec_trie<char>, corpus::urls);
+TRIE_POLICY_BENCHMARKS(set_trie<char>, corpus::urls);
+TRIE_POLICY_BENCHMARKS(arena_trie<char>, corpus::urls);
+TRIE_POLICY_BENCHMARKS(adaptive_trie<char>, corpus::urls);
+TRIE_POLICY_BENCHMARKS(simd_trie<char>, corpus::urls);
+TRIE_POLICY_BENCHMARKS(unordered_trie<char>, corpus::urls);
+TRIE_POLICY_BENCHMARKS(compact_vec_trie<char>, corpus::urls);
+
+/*****************************************************************************/
+// Other structures
+
+template <corpus C>
+static void BM_RadixTrieAdd(benchmark::State& state) {
+	const auto &keys = corpus_keys(C, state.range(0));
+	size_t bytes = 0;
+	for (auto _ : state) {
+		heap_meter meter;
+		auto t = std::make_unique<radix_trie<char>>();
+		add_all(*t, keys);
+		state.PauseTiming();
+		bytes = meter.read();
+		t.reset();
 		state.ResumeTiming();
+	}
+	state.SetItemsProcessed(state.iterations() * keys.size());
+	set_memory_counters(state, bytes, keys.size());
+}
+BENCHMARK_TEMPLATE(BM_RadixTrieAdd, corpus::words)->Apply(corpus_sizes)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_RadixTrieAdd, corpus::urls)->Apply(corpus_sizes)->Unit(benchmark::kMillisecond);
+
+template <corpus C>
+static void BM_RadixTrieFind(benchmark::State& state) {
+	const auto &keys = corpus_keys(C, state.range(0));
+	heap_meter meter;
+	radix_trie<char> t;
+	add_all(t, keys);
+	size_t bytes = meter.read();
+	const auto &queries = zipf_queries(C, state.range(0));
 
-		for (const auto &str : s)
-			t.find_prefix(str);
+	size_t j = 0;
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(t.contains(queries[j++ % queries.size()]));
 	}
+	state.SetItemsProcessed(state.iterations());
+	set_memory_counters(state, bytes, keys.size());
 }
+BENCHMARK_TEMPLATE(BM_RadixTrieFind, corpus::words)->Apply(corpus_sizes);
+BENCHMARK_TEMPLATE(BM_RadixTrieFind, corpus::urls)->Apply(corpus_sizes);
 
-static void BM_UnorderedVecTrieFind(benchmark::State& state) {
-	while (state.KeepRunning()) {
-		state.PauseTiming();
-		trie<char, 255U, std::char_traits<char>, impl_::default_vector_storage, impl_::unordered_vector_accessor> t;
-		auto words = generate_random_words(state.range(0), state.range(1));
-		for (const auto &word : words) {
-			t.add(word);
+template <corpus C>
+static void BM_FrozenTrieFind(benchmark::State& state) {
+	const auto &keys = corpus_keys(C, state.range(0));
+	vec_trie<char> t;
+	add_all(t, keys);
+	heap_meter meter;
+	frozen_trie<char> f{ t };
+	size_t bytes = meter.read();
+	const auto &queries = zipf_queries(C, state.range(0));
+
+	size_t j = 0;
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(f.find_prefix(queries[j++ % queries.size()]));
+	}
+	state.SetItemsProcessed(state.iterations());
+	set_memory_counters(state, bytes, keys.size());
+}
+BENCHMARK_TEMPLATE(BM_FrozenTrieFind, corpus::words)->Apply(corpus_sizes);
+BENCHMARK_TEMPLATE(BM_FrozenTrieFind, corpus::urls)->Apply(corpus_sizes);
+
+template <corpus C>
+static void BM_DawgContains(benchmark::State& state) {
+	std::vector<std::string> keys = corpus_keys(C, state.range(0));
+	std::sort(keys.begin(), keys.end());
+	heap_meter meter;
+	dawg<char> d{ keys.begin(), keys.end() };
+	size_t bytes = meter.read();
+	const auto &queries = zipf_queries(C, state.range(0));
+
+	size_t j = 0;
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(d.contains(queries[j++ % queries.size()]));
+	}
+	state.SetItemsProcessed(state.iterations());
+	set_memory_counters(state, bytes, keys.size());
+	state.counters["states"] = d.state_count();
+}
+BENCHMARK_TEMPLATE(BM_DawgContains, corpus::words)->Apply(corpus_sizes);
+BENCHMARK_TEMPLATE(BM_DawgContains, corpus::urls)->Apply(corpus_sizes);
+
+template <corpus C>
+static void BM_DawgBuild(benchmark::State& state) {
+	std::vector<std::string> keys = corpus_keys(C, state.range(0));
+	std::sort(keys.begin(), keys.end());
+	for (auto _ : state) {
+		dawg<char> d{ keys.begin(), keys.end() };
+		benchmark::DoNotOptimize(d.size());
+	}
+	state.SetItemsProcessed(state.iterations() * keys.size());
+}
+BENCHMARK_TEMPLATE(BM_DawgBuild, corpus::words)->Apply(corpus_sizes)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_DawgBuild, corpus::urls)->Apply(corpus_sizes)->Unit(benchmark::kMillisecond);
+
+// Bottom-up construction from sorted keys, on one thread and on all of them.
+template <corpus C>
+static void BM_VecTrieBuildSorted(benchmark::State& state) {
+	std::vector<std::string> keys = corpus_keys(C, state.range(0));
+	std::sort(keys.begin(), keys.end());
+	for (auto _ : state) {
+		vec_trie<char> t(keys.begin(), keys.end());
+		benchmark::DoNotOptimize(t.size());
+	}
+	state.SetItemsProcessed(state.iterations() * keys.size());
+}
+BENCHMARK_TEMPLATE(BM_VecTrieBuildSorted, corpus::words)->Apply(corpus_sizes)->Unit(benchmark::kMillisecond);
+
+template <corpus C>
+static void BM_VecTrieBuildParallel(benchmark::State& state) {
+	std::vector<std::string> keys = corpus_keys(C, state.range(0));
+	std::sort(keys.begin(), keys.end());
+	for (auto _ : state) {
+		vec_trie<char> t;
+		t.build_sorted_parallel(keys.begin(), keys.end());
+		benchmark::DoNotOptimize(t.size());
+	}
+	state.SetItemsProcessed(state.iterations() * keys.size());
+}
+BENCHMARK_TEMPLATE(BM_VecTrieBuildParallel, corpus::words)->Apply(corpus_sizes)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// A batch of Zipf lookups one by one, and through find_many.
+template <corpus C>
+static void BM_VecTrieFindLoop(benchmark::State& state) {
+	vec_trie<char> t;
+	add_all(t, corpus_keys(C, state.range(0)));
+	const auto &queries = zipf_queries(C, state.range(0));
+	std::vector<std::string_view> batch(queries.begin(), queries.begin() + 1024);
+	std::vector<const vec_trie<char>::node *> out(batch.size());
+
+	for (auto _ : state) {
+		for (size_t j = 0; j < batch.size(); ++j)
+			out[j] = t.find_prefix(batch[j]);
+		benchmark::DoNotOptimize(out.data());
+	}
+	state.SetItemsProcessed(state.iterations() * batch.size());
+}
+BENCHMARK_TEMPLATE(BM_VecTrieFindLoop, corpus::words)->Apply(corpus_sizes)->Unit(benchmark::kMicrosecond);
+
+template <corpus C>
+static void BM_VecTrieFindMany(benchmark::State& state) {
+	vec_trie<char> t;
+	add_all(t, corpus_keys(C, state.range(0)));
+	const auto &queries = zipf_queries(C, state.range(0));
+	std::vector<std::string_view> batch(queries.begin(), queries.begin() + 1024);
+	std::vector<const vec_trie<char>::node *> out(batch.size());
+
+	for (auto _ : state) {
+		t.find_many(batch.begin(), batch.end(), out.begin());
+		benchmark::DoNotOptimize(out.data());
+	}
+	state.SetItemsProcessed(state.iterations() * batch.size());
+}
+BENCHMARK_TEMPLATE(BM_VecTrieFindMany, corpus::words)->Apply(corpus_sizes)->Unit(benchmark::kMicrosecond);
+
+// Greedy tokenization of a text made of stored words.
+static void BM_VecTrieTokenize(benchmark::State& state) {
+	const auto &keys = corpus_keys(corpus::words, state.range(0));
+	vec_trie<char> t;
+	add_all(t, keys);
+	std::string text;
+	for (std::string_view query : zipf_queries(corpus::words, state.range(0))) {
+		text += query;
+		text += ' ';
+	}
+
+	for (auto _ : state) {
+		size_t tokens = 0;
+		t.tokenize(text, [&](std::string_view, bool) { ++tokens; });
+		benchmark::DoNotOptimize(tokens);
+	}
+	state.SetBytesProcessed(state.iterations() * text.size());
+}
+BENCHMARK(BM_VecTrieTokenize)->Apply(corpus_sizes)->Unit(benchmark::kMicrosecond);
+
+// Every occurrence of the stored words in a text made of them.
+static void BM_AhoCorasickScan(benchmark::State& state) {
+	vec_trie<char> t;
+	add_all(t, corpus_keys(corpus::words, state.range(0)));
+	heap_meter meter;
+	aho_corasick<char> ac{ t };
+	size_t bytes = meter.read();
+	std::string text;
+	for (std::string_view query : zipf_queries(corpus::words, state.range(0))) {
+		text += query;
+		text += ' ';
+	}
+
+	for (auto _ : state) {
+		size_t matches = 0;
+		ac.scan(text, [&](size_t, std::string_view) { ++matches; });
+		benchmark::DoNotOptimize(matches);
+	}
+	state.SetBytesProcessed(state.iterations() * text.size());
+	set_memory_counters(state, bytes, ac.size());
+}
+BENCHMARK(BM_AhoCorasickScan)->Apply(corpus_sizes)->Unit(benchmark::kMillisecond);
+
+static constexpr const char *http_methods[] = {
+	"GET", "HEAD", "POST", "PUT", "DELETE", "CONNECT", "OPTIONS", "TRACE", "PATCH"
+};
+
+// Keyword matching against a fixed table, built at compile time or at startup.
+static void BM_StaticTrieContains(benchmark::State& state) {
+	constexpr auto t = make_static_trie<http_methods>();
+	size_t j = 0;
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(t.contains(http_methods[j++ % std::size(http_methods)]));
+	}
+}
+BENCHMARK(BM_StaticTrieContains);
+
+static void BM_VecTrieContainsKeyword(benchmark::State& state) {
+	vec_trie<char> t;
+	for (const char *method : http_methods) {
+		t.add(method);
+	}
+	size_t j = 0;
+	for (auto _ : state) {
+		const auto *n = t.find_prefix(http_methods[j++ % std::size(http_methods)]);
+		benchmark::DoNotOptimize(n && n->marked());
+	}
+}
+BENCHMARK(BM_VecTrieContainsKeyword);
+
+// The words corpus as wide strings, with its letters moved to start at
+// alphabet (U'a' keeps them ASCII, U'\u0430' makes them Cyrillic), plus an
+// emoji on every eighth key.
+static std::vector<std::u32string> wide_keys(const std::vector<std::string_view> &keys, char32_t alphabet) {
+	std::vector<std::u32string> wide;
+	wide.reserve(keys.size());
+	for (std::string_view key : keys) {
+		std::u32string w;
+		for (char c : key) {
+			w.push_back(c >= 'a' && c <= 'z' ? alphabet + (c - 'a') : static_cast<char32_t>(c));
 		}
-		std::vector<std::string> s;
-		std::sample(words.begin(), words.end(), std::back_inserter(s), state.range(2), std::mt19937{ std::random_device{}() });
-		state.ResumeTiming();
+		if (key.size() % 8 == 0) w.push_back(U'\U0001F600');
+		wide.push_back(std::move(w));
+	}
+	return wide;
+}
+
+template <class Trie, char32_t Alphabet>
+static void BM_WideFind(benchmark::State& state) {
+	const auto &corpus = corpus_keys(corpus::words, state.range(0));
+	auto keys = wide_keys({ corpus.begin(), corpus.end() }, Alphabet);
+	auto queries = wide_keys(zipf_queries(corpus::words, state.range(0)), Alphabet);
+	heap_meter meter;
+	Trie t;
+	for (const auto &key : keys) {
+		t.add(key);
+	}
+	size_t bytes = meter.read();
 
-		for (const auto &str : s)
-			t.find_prefix(str);
+	size_t j = 0;
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(t.find_prefix(queries[j++ % queries.size()]));
 	}
+	state.SetItemsProcessed(state.iterations());
+	set_memory_counters(state, bytes, keys.size());
 }
+using simd_utf8_trie = utf8_trie<char32_t, 1023, impl_::split_vector_storage, impl_::simd_vector_accessor>;
+BENCHMARK_TEMPLATE(BM_WideFind, vec_trie<char32_t, 1023>, U'a')->Apply(corpus_sizes);
+BENCHMARK_TEMPLATE(BM_WideFind, utf8_trie<char32_t>, U'a')->Apply(corpus_sizes);
+BENCHMARK_TEMPLATE(BM_WideFind, simd_utf8_trie, U'a')->Apply(corpus_sizes);
+BENCHMARK_TEMPLATE(BM_WideFind, vec_trie<char32_t, 1023>, U'\u0430')->Apply(corpus_sizes);
+BENCHMARK_TEMPLATE(BM_WideFind, utf8_trie<char32_t>, U'\u0430')->Apply(corpus_sizes);
+BENCHMARK_TEMPLATE(BM_WideFind, simd_utf8_trie, U'\u0430')->Apply(corpus_sizes);
 
-static void BM_TrieFindComp(benchmark::State& state) {
+static void BM_TrieMapFind(benchmark::State& state) {
+	const auto &keys = corpus_keys(corpus::words, state.range(0));
+	heap_meter meter;
+	trie_map<char, int> m;
+	for (size_t j = 0; j < keys.size(); ++j) {
+		m.insert_or_assign(keys[j], static_cast<int>(j));
+	}
+	size_t bytes = meter.read();
+	const auto &queries = zipf_queries(corpus::words, state.range(0));
 
-	while (state.KeepRunning()) {
+	size_t j = 0;
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(m.find(queries[j++ % queries.size()]));
+	}
+	state.SetItemsProcessed(state.iterations());
+	set_memory_counters(state, bytes, keys.size());
+}
+BENCHMARK(BM_TrieMapFind)->Apply(corpus_sizes);
+
+// Weighted autocomplete: the ten heaviest keys below a one letter prefix,
+// with query frequencies as weights.
+static void BM_ScoredTrieTop10(benchmark::State& state) {
+	const auto &keys = corpus_keys(corpus::words, state.range(0));
+	std::map<std::string_view, unsigned> frequency;
+	for (std::string_view query : zipf_queries(corpus::words, state.range(0))) {
+		++frequency[query];
+	}
+	scored_trie<char> t;
+	for (const auto &key : keys) {
+		t.add(key, frequency[key]);
+	}
+
+	std::string prefix = "a";
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(t.top_k_completions(prefix, 10));
+		prefix[0] = prefix[0] == 'z' ? 'a' : prefix[0] + 1;
+	}
+}
+BENCHMARK(BM_ScoredTrieTop10)->Apply(corpus_sizes)->Unit(benchmark::kMicrosecond);
+
+// Startup cost of a saved trie; compare with BM_Add for a rebuild.
+static void BM_MappedTrieOpen(benchmark::State& state) {
+	const std::string path = "bm_mapped_trie.bin";
+	{
+		vec_trie<char> t;
+		add_all(t, corpus_keys(corpus::urls, state.range(0)));
+		t.save(path);
+	}
+
+	for (auto _ : state) {
+		auto m = mapped_trie<char>::open(path);
+		benchmark::DoNotOptimize(m.contains("/api"));
+	}
+	std::remove(path.c_str());
+}
+BENCHMARK(BM_MappedTrieOpen)->Apply(corpus_sizes)->Unit(benchmark::kMicrosecond);
+
+static void BM_ConcurrentTrieFind(benchmark::State& state) {
+	// Shared by all the reader threads; static initialization is thread-safe.
+	static const std::vector<std::string_view> &queries = zipf_queries(corpus::words, 1 << 15);
+	static const concurrent_trie<char> &t = *[] {
+		auto *t = new concurrent_trie<char>;
+		for (const auto &key : corpus_keys(corpus::words, 1 << 15))
+			t->add(key);
+		return t;
+	}();
+
+	size_t j = state.thread_index() * 4099;
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(t.contains(queries[j++ % queries.size()]));
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ConcurrentTrieFind)->ThreadRange(1, 8)->UseRealTime();
+
+static void BM_ConcurrentInsertTrieAdd(benchmark::State& state) {
+	static const std::vector<std::string> &keys = corpus_keys(corpus::urls, 1 << 16);
+	static concurrent_insert_trie<char> *t = nullptr;
+	// Threads wait for each other when entering and leaving the loop.
+	if (state.thread_index() == 0) t = new concurrent_insert_trie<char>;
+
+	size_t j = state.thread_index();
+	for (auto _ : state) {
+		t->add(keys[j++ % keys.size()]);
+	}
+	state.SetItemsProcessed(state.iterations());
+
+	if (state.thread_index() == 0) delete t;
+}
+BENCHMARK(BM_ConcurrentInsertTrieAdd)->ThreadRange(1, 8)->UseRealTime();
+
+// Same on random keys over 61 symbols, so the first levels are wide enough
+// to be indexed.
+static void BM_ConcurrentInsertTrieAddWide(benchmark::State& state) {
+	static const std::vector<std::string> keys = generate_random_words(1 << 16, 8);
+	static concurrent_insert_trie<char> *t = nullptr;
+	if (state.thread_index() == 0) t = new concurrent_insert_trie<char>;
+
+	size_t j = state.thread_index();
+	for (auto _ : state) {
+		t->add(keys[j++ % keys.size()]);
+	}
+	state.SetItemsProcessed(state.iterations());
+
+	if (state.thread_index() == 0) delete t;
+}
+BENCHMARK(BM_ConcurrentInsertTrieAddWide)->ThreadRange(1, 8)->UseRealTime();
+
+// Node size and footprint of the full and compact node layouts on keys that
+// share nothing.
+template <class Trie>
+static void BM_RandomKeysFootprint(benchmark::State& state) {
+	auto keys = generate_random_words(state.range(0), 16);
+	std::sort(keys.begin(), keys.end());
+	size_t bytes = 0;
+	for (auto _ : state) {
+		heap_meter meter;
+		auto t = std::make_unique<Trie>(keys.begin(), keys.end());
 		state.PauseTiming();
-		Trie t;
-		auto words = generate_random_words(state.range(0), state.range(1));
-		t.build_trie(words.data(), words.size());
-		std::vector<std::string> s;
-		std::sample(words.begin(), words.end(), std::back_inserter(s), state.range(2), std::mt19937{ std::random_device{}() });
-		bool res;
+		bytes = meter.read();
+		t.reset();
 		state.ResumeTiming();
-		for (const auto &str : s)
-			(t.search(str, res));
 	}
+	state.counters["node_size"] = sizeof(typename Trie::node);
+	set_memory_counters(state, bytes, keys.size());
 }
-// ranges are : words in trie - length - numsamples
-std::vector<std::pair<int, int>> ranges = { { 512, 4096 },{ 16, 64 } ,{8, 64} };
-BENCHMARK(BM_SetTrieFind)->Ranges(ranges)->Unit(benchmark::kMicrosecond);
-BENCHMARK(BM_VecTrieFind)->Ranges(ranges)->Unit(benchmark::kMicrosecond);
-BENCHMARK(BM_UnorderedVecTrieFind)->Ranges(ranges)->Unit(benchmark::kMicrosecond);
-BENCHMARK(BM_TrieFindComp)->Ranges(ranges)->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_RandomKeysFootprint, vec_trie<char>)->Apply(corpus_sizes)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_RandomKeysFootprint, compact_vec_trie<char>)->Apply(corpus_sizes)->Unit(benchmark::kMillisecond);
+
+// Baseline: a std::map per node (see comparison.h).
+static void BM_MapTrieAdd(benchmark::State& state) {
+	std::vector<std::string> keys = corpus_keys(corpus::words, state.range(0));
+	for (auto _ : state) {
+		Trie t;
+		t.build_trie(keys.data(), static_cast<int>(keys.size()));
+	}
+	state.SetItemsProcessed(state.iterations() * keys.size());
+}
+BENCHMARK(BM_MapTrieAdd)->Apply(corpus_sizes)->Unit(benchmark::kMillisecond);
 
 int main(int argc, char** argv) {
-	//std::cout << sizeof(trie<char, 255>::node) << std::endl << sizeof(trie<char, 512>::node) << std::endl;
-	::benchmark::Initialize(&argc, argv);  
-	if (::benchmark::ReportUnrecognizedArguments(argc, argv)) 
-		return 1; 
+	std::cout << "sizeof(node): trie<char, 255> " << sizeof(trie<char, 255>::node)
+		<< ", trie<char, 512> " << sizeof(trie<char, 512>::node)
+		<< ", compact_trie<char> " << sizeof(compact_trie<char>::node) << std::endl;
+	::benchmark::Initialize(&argc, argv);
+	if (::benchmark::ReportUnrecognizedArguments(argc, argv))
+		return 1;
 	::benchmark::RunSpecifiedBenchmarks();
-
-	system("PAUSE");
-}
\ No newline at end of file
+	::benchmark::Shutdown();
+}
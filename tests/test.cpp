@@ -1,6 +1,22 @@
 #include <vector>
 
 #include "../trie.hpp"
+#include "../frozen_trie.hpp"
+#include "../radix_trie.hpp"
+#include "../mapped_trie.hpp"
+#include "../scored_trie.hpp"
+#include "../trie_map.hpp"
+#include "../concurrent_trie.hpp"
+#include "../static_trie.hpp"
+#include "../aho_corasick.hpp"
+#include "../utf8_trie.hpp"
+#include "../dawg.hpp"
+
+#include <thread>
+#include <random>
+#include <fstream>
+#include <filesystem>
+#include <atomic>
 
 #include "gtest/gtest.h"
 
@@ -101,6 +117,225 @@ TEST(trie, add_remove) {
 		t.remove(s);
 	}
 	ASSERT_EQ(t.size(), 0);
+	ASSERT_TRUE(t.find_prefix("")->leaf());
+}
+
+template <class Node>
+static size_t count_nodes(const Node &n) {
+	size_t count = 1;
+	for (const Node &child : n.get_elements()) {
+		count += count_nodes(child);
+	}
+	return count;
+}
+
+template <class Trie>
+static void check_remove() {
+	Trie t;
+	for (auto &s : words) {
+		t.add(s);
+	}
+	t.add("tan");
+	size_t nodes = count_nodes(*t.find_prefix(""));
+
+	// Unknown keys and prefixes that are not keys change nothing.
+	t.remove("ta");
+	t.remove("tangle");
+	ASSERT_EQ(t.size(), words.size() + 1);
+
+	// "tangy" below the key "tan": only "gy" goes.
+	t.remove("tangy");
+	t.remove("tangy");
+	ASSERT_EQ(t.size(), words.size());
+	ASSERT_EQ(count_nodes(*t.find_prefix("")), nodes - 2);
+	ASSERT_TRUE(t.find_prefix("tan")->leaf());
+	ASSERT_EQ(t.find_prefix("tang"), nullptr);
+
+	// An internal key only loses its mark.
+	t.remove("tan");
+	ASSERT_EQ(t.find_prefix("tan"), nullptr);
+	ASSERT_EQ(t.find_prefix("t")->paths_to('e', 2).size(), 2);
+	ASSERT_EQ(t.find_prefix("t")->paths_to('e', 3).size(), 0);
+
+	for (auto &s : words) {
+		t.remove(s);
+	}
+	ASSERT_EQ(t.size(), 0);
+	ASSERT_EQ(count_nodes(*t.find_prefix("")), 1);
+	ASSERT_TRUE(t.find_prefix("")->leaf());
+
+	t.add("tangy");
+	ASSERT_EQ(t.complete_suggestions("t"), std::vector<std::string>{ "tangy" });
+}
+
+TEST(trie, remove_prunes_branches) {
+	check_remove<trie<char>>();
+	check_remove<trie<char, 255U, std::char_traits<char>, impl_::default_vector_storage, impl_::unordered_vector_accessor>>();
+	check_remove<trie<char, 255U, std::char_traits<char>, impl_::default_set_storage, impl_::default_set_storage_accessor>>();
+	check_remove<trie<char, 255U, std::char_traits<char>, impl_::arena_vector_storage, impl_::default_vector_accessor>>();
+	check_remove<trie<char, 255U, std::char_traits<char>, impl_::adaptive_storage, impl_::adaptive_accessor>>();
+	check_remove<trie<char, 255U, std::char_traits<char>, impl_::split_vector_storage, impl_::simd_vector_accessor>>();
+	check_remove<compact_trie<char>>();
+	check_remove<compact_trie<char, std::char_traits<char>, impl_::adaptive_storage, impl_::adaptive_accessor>>();
+}
+
+TEST(trie, compact) {
+	trie<char> t, expected;
+	for (auto &s : words) {
+		t.add(s);
+		expected.add(s);
+	}
+	// A branch without keys, as left behind by editing nodes directly.
+	t.find_prefix("t")->get_or_emplace('z')->get_or_emplace('z');
+	size_t nodes = count_nodes(*t.find_prefix(""));
+
+	t.compact();
+	ASSERT_EQ(count_nodes(*t.find_prefix("")), nodes - 2);
+	ASSERT_EQ(t.find_prefix("tz"), nullptr);
+	ASSERT_EQ(t.complete_suggestions(""), expected.complete_suggestions(""));
+	ASSERT_EQ(t.find_prefix("t")->paths_to('e', 3).size(), expected.find_prefix("t")->paths_to('e', 3).size());
+}
+
+TEST(trie, stats) {
+	trie<char> t;
+	for (auto s : { "tan", "tangy", "ten" }) {
+		t.add(s);
+	}
+	trie_stats stats = t.stats();
+	ASSERT_EQ(stats.keys, 3);
+	ASSERT_EQ(stats.nodes, 8);
+	ASSERT_EQ(stats.fanout, (std::vector<size_t>{ 2, 5, 1 }));
+	ASSERT_EQ(stats.depth, (std::vector<size_t>{ 1, 1, 2, 2, 1, 1 }));
+	ASSERT_GE(stats.bytes, 7 * sizeof(trie<char>::node));
+	ASSERT_EQ(stats.to_json().find("{\"keys\":3,\"nodes\":8,"), 0);
+	ASSERT_NE(stats.to_json().find("\"fanout\":[2,5,1]"), std::string::npos);
+
+	t.find_prefix("tang");
+	t.find_prefix("tx");
+	t.complete_suggestions("ta");
+	t.closest_matches("tin");
+	stats = t.stats();
+	if (impl_::stats_enabled) {
+		ASSERT_EQ(stats.find_prefix.calls, 3);
+		ASSERT_EQ(stats.find_prefix.nodes_visited, 4 + 1 + 2);
+		ASSERT_EQ(stats.complete_suggestions.calls, 1);
+		ASSERT_EQ(stats.complete_suggestions.nodes_visited, 3);
+		ASSERT_EQ(stats.closest_matches.calls, 1);
+		ASSERT_GT(stats.closest_matches.nodes_visited, 0);
+		t.reset_stats();
+		ASSERT_EQ(t.stats().find_prefix.calls, 0);
+
+		// Batched lookups count like single ones.
+		std::string_view queries[] = { "tang", "tx" };
+		const trie<char>::node *found[2];
+		t.find_many(std::begin(queries), std::end(queries), found);
+		ASSERT_EQ(t.stats().find_prefix.calls, 2);
+		ASSERT_EQ(t.stats().find_prefix.nodes_visited, 4 + 1);
+	}
+	else {
+		ASSERT_EQ(stats.find_prefix.calls, 0);
+	}
+
+	// Tries stay movable with the counters compiled in, and keep them. The
+	// moved tries must not depend on their sources, which are gone by the
+	// time keys are added and removed.
+	size_t calls = t.stats().find_prefix.calls;
+	auto has = [](const trie<char> &tr, std::string_view key) {
+		auto *n = tr.find_prefix(key);
+		return n && n->marked();
+	};
+	auto src = std::make_unique<trie<char>>(std::move(t));
+	ASSERT_EQ(t.size(), 0);
+	ASSERT_EQ(t.find_prefix("tangy"), nullptr);
+	auto moved = std::make_unique<trie<char>>(std::move(*src));
+	src.reset();
+	ASSERT_EQ(moved->stats().find_prefix.calls, calls);
+	ASSERT_TRUE(moved->find_prefix("tangy")->marked());
+	moved->add("tanx");
+	moved->add("z");
+	moved->remove("tangy");
+	ASSERT_TRUE(has(*moved, "tanx"));
+	ASSERT_FALSE(has(*moved, "tangy"));
+	ASSERT_EQ(moved->find_prefix("")->height(), 4);
+
+	trie<char> assigned;
+	assigned.add("old");
+	assigned = std::move(*moved);
+	moved.reset();
+	ASSERT_EQ(assigned.stats().keys, 4);
+	ASSERT_FALSE(has(assigned, "old"));
+	assigned.add("tangerine");
+	assigned.remove("tanx");
+	assigned.remove("z");
+	ASSERT_TRUE(has(assigned, "tangerine"));
+	ASSERT_EQ(assigned.find_prefix("")->height(), 9);
+
+	trie<char, 255U, std::char_traits<char>, impl_::arena_vector_storage, impl_::default_vector_accessor> arena_t;
+	arena_t.add("tangy");
+	ASSERT_GT(arena_t.stats().arena_bytes, 0);
+}
+
+TEST(trie, build_sorted) {
+	std::vector<std::string> sorted = words;
+	sorted.push_back("tan");
+	sorted.push_back("tangy");
+	std::sort(sorted.begin(), sorted.end());
+
+	trie<char> expected;
+	for (auto &s : sorted) {
+		expected.add(s);
+	}
+
+	trie<char> t(sorted.begin(), sorted.end());
+	ASSERT_EQ(t.size(), expected.size());
+	ASSERT_EQ(t.complete_suggestions(""), expected.complete_suggestions(""));
+	ASSERT_TRUE(t.find_prefix("tangy")->leaf());
+	ASSERT_TRUE(t.find_prefix("tan")->marked());
+	ASSERT_FALSE(t.find_prefix("ta")->marked());
+
+	// Heights must match the ones maintained by add.
+	for (unsigned height = 0; height < 5; ++height) {
+		for (char c : std::string("aen")) {
+			ASSERT_EQ(t.find_prefix("t")->paths_to(c, height).size(), expected.find_prefix("t")->paths_to(c, height).size());
+		}
+	}
+
+	// Building into a non-empty trie goes through add.
+	t.build_sorted(sorted.begin(), sorted.begin() + 1);
+	ASSERT_EQ(t.size(), expected.size());
+
+	trie<char, 255U, std::char_traits<char>, impl_::adaptive_storage, impl_::adaptive_accessor> a(sorted.begin(), sorted.end());
+	ASSERT_EQ(a.complete_suggestions("t"), expected.complete_suggestions("t"));
+	trie<char, 255U, std::char_traits<char>, impl_::default_set_storage, impl_::default_set_storage_accessor> b(sorted.begin(), sorted.end());
+	ASSERT_EQ(b.complete_suggestions("s"), expected.complete_suggestions("s"));
+	trie<char, 255U, std::char_traits<char>, impl_::split_vector_storage, impl_::simd_vector_accessor> c(sorted.begin(), sorted.end());
+	ASSERT_EQ(c.complete_suggestions("p"), expected.complete_suggestions("p"));
+	trie<char, 255U, std::char_traits<char>, impl_::arena_vector_storage, impl_::default_vector_accessor> d(sorted.begin(), sorted.end());
+	ASSERT_EQ(d.complete_suggestions("d"), expected.complete_suggestions("d"));
+}
+
+TEST(trie, build_sorted_parallel) {
+	// Skewed on purpose: most keys share their first two characters.
+	std::vector<std::string> sorted;
+	for (int j = 0; j < 5000; ++j) {
+		sorted.push_back("/a" + std::to_string(j * 7919 % 10007));
+		if (j % 10 == 0) sorted.push_back(std::to_string(j));
+	}
+	sorted.push_back("/a");
+	sorted.push_back("/a");
+	std::sort(sorted.begin(), sorted.end());
+
+	trie<char> expected(sorted.begin(), sorted.end());
+	trie<char> t;
+	t.build_sorted_parallel(sorted.begin(), sorted.end(), 4);
+
+	ASSERT_EQ(t.size(), expected.size());
+	ASSERT_EQ(t.complete_suggestions(""), expected.complete_suggestions(""));
+	ASSERT_TRUE(t.find_prefix("/a")->marked());
+	for (unsigned height = 0; height < 7; ++height) {
+		ASSERT_EQ(t.find_prefix("")->paths_to('a', height).size(), expected.find_prefix("")->paths_to('a', height).size());
+		ASSERT_EQ(t.find_prefix("/a")->paths_to('1', height).size(), expected.find_prefix("/a")->paths_to('1', height).size());
+	}
 }
 
 TEST(trie, char_suggestions) {
@@ -123,6 +358,85 @@ TEST(trie, char_suggestions) {
 	ASSERT_EQ(t.complete_suggestions("j"), expected_j);
 }
 
+TEST(trie, find_many) {
+	trie<char> t;
+	for (auto &s : words) {
+		t.add(s);
+	}
+
+	std::vector<std::string_view> keys{ "tiger", "", "brawn", "brawl", "t" };
+	for (auto &s : words) {
+		keys.push_back(s);
+	}
+	std::vector<const trie<char>::node *> found(keys.size());
+	t.find_many(keys.begin(), keys.end(), found.begin());
+	for (size_t j = 0; j < keys.size(); ++j) {
+		ASSERT_EQ(found[j], t.find_prefix(keys[j])) << keys[j];
+	}
+	ASSERT_EQ(found[3], nullptr);
+}
+
+TEST(trie, longest_prefix_match) {
+	trie<char> t;
+	for (auto s : { "/api", "/api/users", "/api/users/", "/static" }) {
+		t.add(s);
+	}
+	ASSERT_EQ(t.longest_prefix_match("/api/users/42").second, 11);
+	ASSERT_EQ(t.longest_prefix_match("/api/user").second, 4);
+	ASSERT_EQ(t.longest_prefix_match("/api/user").first, t.find_prefix("/api"));
+	ASSERT_EQ(t.longest_prefix_match("/api").second, 4);
+	ASSERT_EQ(t.longest_prefix_match("/ap").first, nullptr);
+	ASSERT_EQ(t.longest_prefix_match("").first, nullptr);
+
+	trie<char> vocab;
+	for (auto s : { "un", "bel", "believ", "able", "a" }) {
+		vocab.add(s);
+	}
+	std::vector<std::pair<std::string, bool>> tokens;
+	vocab.tokenize("xunbelievable!!a", [&](std::string_view token, bool known) {
+		tokens.emplace_back(token, known);
+	});
+	std::vector<std::pair<std::string, bool>> expected{
+		{ "x", false }, { "un", true }, { "believ", true }, { "able", true }, { "!!", false }, { "a", true }
+	};
+	ASSERT_EQ(tokens, expected);
+}
+
+TEST(trie, lazy_completions) {
+	trie<char> t;
+	for (auto &s : words) {
+		t.add(s);
+	}
+	t.add("tan");
+
+	// The prefix itself comes first, then the rest depth first.
+	std::vector<std::string> expected_t{
+		"tan",
+		"tangy",
+		"teeth",
+		"tent",
+		"tiger",
+		"treat"
+	};
+	std::vector<std::string> actual;
+	for (std::string_view key : t.completions("t")) {
+		actual.emplace_back(key);
+	}
+	ASSERT_EQ(actual, expected_t);
+	ASSERT_EQ(t.complete_suggestions("t"), expected_t);
+
+	// Stopping early only walks as far as needed.
+	auto range = t.completions("t");
+	auto it = range.begin();
+	ASSERT_EQ(*it, "tan");
+	ASSERT_EQ(*++it, "tangy");
+
+	auto missing = t.completions("z");
+	ASSERT_TRUE(missing.begin() == missing.end());
+	auto unmarked = t.completions("tig");
+	ASSERT_EQ(std::distance(unmarked.begin(), unmarked.end()), 1);
+}
+
 TEST(trie, wchar_t_suggestions) {
 	trie<wchar_t> t;
 	for (auto &s : wwords) {
@@ -166,6 +480,72 @@ TEST(trie, unicode_suggestions) {
 	ASSERT_EQ(t.complete_suggestions(U"j"), expected_j);
 }
 
+TEST(utf8_trie, matches_trie) {
+	std::vector<std::u32string> keys = uwords;
+	keys.insert(keys.end(), {
+		U"a\u20AC", U"caf\u00E9", U"cafe", U"caf\u00E8", U"\u4E2D\u6587",
+		U"\u4E2D\u56FD", U"\U0001F600", U"\U0001F600!", U"na\u00EFve"
+	});
+	trie<char32_t> expected;
+	utf8_trie<char32_t> t;
+	utf8_trie<char32_t, 1023, impl_::split_vector_storage, impl_::simd_vector_accessor> simd;
+	for (auto &s : keys) {
+		expected.add(s);
+		t.add(s);
+		simd.add(s);
+	}
+	static_assert(sizeof(utf8_trie<char32_t>::node::value_type) == 1);
+	ASSERT_EQ(t.size(), keys.size());
+	ASSERT_TRUE(t.contains(U"caf\u00E9"));
+	ASSERT_FALSE(t.contains(U"caf"));
+	ASSERT_FALSE(t.contains(U"\u4E2D"));
+
+	for (std::u32string prefix : { U"", U"a", U"caf", U"\u4E2D", U"\U0001F600", U"x" }) {
+		ASSERT_EQ(t.complete_suggestions(prefix), expected.complete_suggestions(prefix));
+		ASSERT_EQ(simd.complete_suggestions(prefix), expected.complete_suggestions(prefix));
+	}
+
+	// Edits count code points, not bytes: \u00E9 and \u00E8 differ in one
+	// byte, and \u4E2D\u6587 and \u4E2D\u56FD in two.
+	for (std::u32string query : { U"caf\u00EA", U"\u4E2D\u6587", U"naive", U"tenth", U"\U0001F601!" }) {
+		ASSERT_EQ(t.closest_matches(query, 1), expected.closest_matches(query, 1));
+		ASSERT_EQ(t.closest_matches(query, 2, true), expected.closest_matches(query, 2, true));
+	}
+
+	// Values past U+10FFFF have no UTF-8 encoding: they are never found and
+	// cannot be added, rather than aliasing another key.
+	std::u32string too_large{ U'a', static_cast<char32_t>(0x110000) };
+	ASSERT_THROW(t.add(too_large), std::invalid_argument);
+	ASSERT_THROW(t.add(std::u32string{ static_cast<char32_t>(0xFFFFFFFF) }), std::invalid_argument);
+	ASSERT_FALSE(t.contains(too_large));
+	ASSERT_TRUE(t.complete_suggestions(too_large).empty());
+	t.remove(too_large);
+	ASSERT_EQ(t.size(), keys.size());
+	t.add(U"\U0010FFFF");
+	ASSERT_TRUE(t.contains(U"\U0010FFFF"));
+	t.remove(U"\U0010FFFF");
+
+	t.remove(U"\u4E2D\u6587");
+	ASSERT_FALSE(t.contains(U"\u4E2D\u6587"));
+	ASSERT_EQ(t.complete_suggestions(U"\u4E2D"), std::vector<std::u32string>{ U"\u4E2D\u56FD" });
+
+	// wchar_t keys are UTF-16 where wchar_t is 16 bits wide.
+	utf8_trie<wchar_t> w;
+	for (auto &s : wwords) {
+		w.add(s);
+	}
+	w.add(L"caf\u00E9");
+	w.add(L"\U0001F600");
+	std::vector<std::wstring> expected_a{
+		L"afterthought",
+		L"alike",
+		L"apologise"
+	};
+	ASSERT_EQ(w.complete_suggestions(L"a"), expected_a);
+	ASSERT_EQ(w.closest_matches(L"cafe"), std::vector<std::wstring>{ L"caf\u00E9" });
+	ASSERT_EQ(w.complete_suggestions(L"\U0001F600"), std::vector<std::wstring>{ L"\U0001F600" });
+}
+
 TEST(trie, closest_match) {
 	trie<char> t;
 
@@ -182,7 +562,8 @@ TEST(trie, closest_match) {
 	}
 
 	// Test word length
-	ASSERT_EQ(t.closest_matches("aftert").size(), 0);
+	ASSERT_EQ(t.closest_matches("aftert").size(), 1);
+	ASSERT_EQ(t.closest_matches("aftertt").size(), 0);
 	ASSERT_EQ(t.closest_matches("ame").size(), 3);
 
 	// Test last character typo
@@ -191,7 +572,49 @@ TEST(trie, closest_match) {
 	// Test second-to-last character typo
 	ASSERT_EQ(t.closest_matches("avo").size(), 1);
 
+	// Test first character typo
+	ASSERT_EQ(t.closest_matches("bfter"), std::vector<std::string>{ "after" });
+
+	// Test transposition
+	ASSERT_EQ(t.closest_matches("exatc").size(), 0);
+	ASSERT_EQ(t.closest_matches("exatc", 2), std::vector<std::string>{ "exact" });
+	ASSERT_EQ(t.closest_matches("exatc", 1, true), std::vector<std::string>{ "exact" });
+}
+
+static size_t edit_distance(const std::string &a, const std::string &b) {
+	std::vector<std::vector<size_t>> d(a.size() + 1, std::vector<size_t>(b.size() + 1));
+	for (size_t i = 0; i <= a.size(); ++i) d[i][0] = i;
+	for (size_t j = 0; j <= b.size(); ++j) d[0][j] = j;
+	for (size_t i = 1; i <= a.size(); ++i) {
+		for (size_t j = 1; j <= b.size(); ++j) {
+			d[i][j] = std::min({ d[i - 1][j] + 1, d[i][j - 1] + 1, d[i - 1][j - 1] + (a[i - 1] != b[j - 1]) });
+		}
+	}
+	return d[a.size()][b.size()];
+}
+
+TEST(trie, closest_matches_edit_distance) {
+	trie<char> t;
+	radix_trie<char> r;
+	for (auto &s : words) {
+		t.add(s);
+		r.add(s);
+	}
+	frozen_trie f{ t };
+
+	for (std::string query : { "tent", "tnet", "brawn", "hsitant", "x", "", "ones", "danc" }) {
+		for (unsigned changes = 0; changes < 4; ++changes) {
+			std::vector<std::string> expected;
+			for (auto &s : words) {
+				if (edit_distance(query, s) <= changes) expected.push_back(s);
+			}
+			std::sort(expected.begin(), expected.end());
 
+			ASSERT_EQ(t.closest_matches(query, changes), expected) << query << " " << changes;
+			ASSERT_EQ(f.closest_matches(query, changes), expected) << query << " " << changes;
+			ASSERT_EQ(r.closest_matches(query, changes), expected) << query << " " << changes;
+		}
+	}
 }
 
 TEST(unordered_trie, suggestions) {
@@ -215,6 +638,635 @@ TEST(unordered_trie, suggestions) {
 	ASSERT_EQ(t.complete_suggestions("j"), expected_j);
 }
 
+TEST(arena_trie, suggestions) {
+	trie<char, 255U, std::char_traits<char>, impl_::arena_vector_storage, impl_::default_vector_accessor> t;
+	for (auto &s : words) {
+		t.add(s);
+	}
+	ASSERT_EQ(t.size(), words.size());
+
+	std::vector<std::string> expected_a{
+		"afterthought",
+		"alike",
+		"apologise"
+	};
+	ASSERT_EQ(t.complete_suggestions("a"), expected_a);
+	ASSERT_EQ(utils::node_to_string(t.find_prefix("brawn")), "brawn");
+	ASSERT_EQ(t.find_prefix("brawl"), nullptr);
+}
+
+TEST(compact_trie, matches_trie) {
+	static_assert(sizeof(compact_trie<char>::node) < sizeof(trie<char>::node));
+
+	std::vector<std::string> sorted = words;
+	std::sort(sorted.begin(), sorted.end());
+	trie<char> expected{ sorted.begin(), sorted.end() };
+	compact_trie<char> t{ sorted.begin(), sorted.end() };
+	ASSERT_EQ(t.size(), words.size());
+	ASSERT_EQ(t.complete_suggestions(""), expected.complete_suggestions(""));
+	ASSERT_EQ(t.closest_matches("tenth", 2), expected.closest_matches("tenth", 2));
+	ASSERT_TRUE(t.find_prefix("burrito")->leaf());
+	ASSERT_FALSE(t.find_prefix("burr")->leaf());
+	ASSERT_EQ(t.find_prefix("a")->height(), expected.find_prefix("a")->height());
+
+	const compact_trie<char>::node *root = t.find_prefix("");
+	ASSERT_EQ(utils::node_to_string(root, t.find_prefix("brawn")), "brawn");
+	ASSERT_EQ(utils::node_to_string(root, root), "");
+	ASSERT_EQ(utils::node_to_string(t.find_prefix("b"), t.find_prefix("j")), "");
+}
+
+TEST(node_arena, reuses_freed_chunks) {
+	impl_::node_arena arena;
+	void *p = arena.allocate(24);
+	arena.deallocate(p, 24);
+	ASSERT_EQ(arena.allocate(32), p);
+	ASSERT_NE(arena.allocate(32), p);
+	ASSERT_EQ(arena.bytes_reserved(), impl_::node_arena::block_size);
+}
+
+TEST(adaptive_trie, suggestions) {
+	trie<char, 255U, std::char_traits<char>, impl_::adaptive_storage, impl_::adaptive_accessor> t;
+	for (auto &s : words) {
+		t.add(s);
+	}
+	ASSERT_EQ(t.size(), words.size());
+
+	std::vector<std::string> expected_a{
+		"afterthought",
+		"alike",
+		"apologise"
+	};
+	ASSERT_EQ(t.complete_suggestions("a"), expected_a);
+	ASSERT_EQ(utils::node_to_string(t.find_prefix("shel")), "shel");
+	ASSERT_EQ(t.find_prefix("shelf"), nullptr);
+}
+
+TEST(adaptive_trie, grows_through_node_kinds) {
+	using adaptive_trie = trie<char, 255U, std::char_traits<char>, impl_::adaptive_storage, impl_::adaptive_accessor>;
+	using children = impl_::adaptive_children<adaptive_trie::node>;
+	adaptive_trie t;
+
+	// Insert every byte in a scrambled order under "x".
+	std::vector<std::string> expected;
+	for (int j = 0; j < 256; ++j) {
+		std::string key = "x";
+		key += static_cast<char>((j * 97) % 256);
+		t.add(key);
+
+		auto kind = t.find_prefix("x")->get_children().kind();
+		if (j == 3) {
+			ASSERT_EQ(kind, children::node4);
+		}
+		else if (j == 15) {
+			ASSERT_EQ(kind, children::node16);
+		}
+		else if (j == 47) {
+			ASSERT_EQ(kind, children::node48);
+		}
+		else if (j == 48) {
+			ASSERT_EQ(kind, children::node256);
+		}
+	}
+	for (int j = 0; j < 256; ++j) {
+		expected.push_back(std::string("x") + static_cast<char>(j));
+		ASSERT_NE(t.find_prefix(expected.back()), nullptr);
+	}
+	ASSERT_EQ(t.size(), 256);
+	ASSERT_EQ(t.complete_suggestions("x"), expected);
+
+	// And back down as they are removed.
+	for (int j = 255; j >= 0; --j) {
+		t.remove(std::string("x") + static_cast<char>((j * 97) % 256));
+		if (j == 0) break;
+
+		auto kind = t.find_prefix("x")->get_children().kind();
+		if (j == 37) {
+			ASSERT_EQ(kind, children::node256);
+		}
+		else if (j == 36) {
+			ASSERT_EQ(kind, children::node48);
+		}
+		else if (j == 12) {
+			ASSERT_EQ(kind, children::node16);
+		}
+		else if (j == 2) {
+			ASSERT_EQ(kind, children::node4);
+		}
+		ASSERT_EQ(t.complete_suggestions("x").size(), static_cast<size_t>(j));
+	}
+	ASSERT_EQ(t.find_prefix("x"), nullptr);
+}
+
+TEST(simd_trie, suggestions) {
+	using simd_trie = trie<char, 255U, std::char_traits<char>, impl_::split_vector_storage, impl_::simd_vector_accessor>;
+	simd_trie t;
+	for (auto &s : words) {
+		t.add(s);
+	}
+	ASSERT_EQ(t.size(), words.size());
+
+	std::vector<std::string> expected_a{
+		"afterthought",
+		"alike",
+		"apologise"
+	};
+	ASSERT_EQ(t.complete_suggestions("a"), expected_a);
+
+	// Fill one node across several SIMD blocks, including bytes above 0x7f.
+	std::vector<std::string> expected;
+	for (int j = 0; j < 256; ++j) {
+		t.add(std::string("~") + static_cast<char>((j * 97) % 256));
+	}
+	for (int j = 0; j < 256; ++j) {
+		expected.push_back(std::string("~") + static_cast<char>(j));
+		ASSERT_NE(t.find_prefix(expected.back()), nullptr);
+	}
+	ASSERT_EQ(t.complete_suggestions("~"), expected);
+	ASSERT_EQ(t.find_prefix("~a~"), nullptr);
+}
+
+TEST(bitmap_trie, restricted_alphabet) {
+	using host_traits = impl_::alphabet_traits<impl_::hostname_alphabet>;
+	using host_trie = trie<char, 255U, host_traits, impl_::bitmap_storage, impl_::bitmap_accessor>;
+	static_assert(host_traits::alphabet_size == 39);
+	static_assert(host_traits::index('-') == 0 && host_traits::index('z') == 38);
+	static_assert(host_traits::index('A') == host_traits::npos && host_traits::symbol(12) == '_');
+	static_assert(sizeof(host_trie::node) < sizeof(trie<char>::node));
+
+	auto view = [](const std::string &s) {
+		return host_trie::string_view{ s.data(), s.size() };
+	};
+	auto plain = [](const std::vector<host_trie::string> &keys) {
+		std::vector<std::string> results;
+		for (auto &key : keys) {
+			results.emplace_back(key.data(), key.size());
+		}
+		return results;
+	};
+
+	host_trie t;
+	trie<char> expected;
+	for (auto &s : words) {
+		t.add(view(s));
+		expected.add(s);
+	}
+	ASSERT_EQ(t.size(), words.size());
+	ASSERT_EQ(plain(t.complete_suggestions({})), expected.complete_suggestions(""));
+	ASSERT_EQ(plain(t.complete_suggestions("t")), expected.complete_suggestions("t"));
+	ASSERT_EQ(plain(t.closest_matches("tenth", 2)), expected.closest_matches("tenth", 2));
+
+	// Symbols outside the alphabet are never found, and cannot be added.
+	ASSERT_EQ(t.find_prefix("Tiger"), nullptr);
+	ASSERT_THROW(t.add("Tiger"), std::invalid_argument);
+	ASSERT_EQ(t.size(), words.size());
+
+	// One node through every symbol, then back down to one child.
+	std::vector<std::string> all;
+	for (unsigned j = host_traits::alphabet_size; j-- > 0;) {
+		t.add(view(std::string("x") + host_traits::symbol(j)));
+	}
+	for (unsigned j = 0; j < host_traits::alphabet_size; ++j) {
+		all.push_back(std::string("x") + host_traits::symbol(j));
+	}
+	ASSERT_EQ(plain(t.complete_suggestions("x")), all);
+	for (unsigned j = 1; j < host_traits::alphabet_size; ++j) {
+		t.remove(view(all[j]));
+	}
+	ASSERT_EQ(plain(t.complete_suggestions("x")), std::vector<std::string>{ "x-" });
+	ASSERT_EQ(t.find_prefix("x")->raw_storage().capacity(), 1U);
+
+	using dna_trie = trie<char, 255U, impl_::alphabet_traits<impl_::dna_alphabet>, impl_::bitmap_storage, impl_::bitmap_accessor>;
+	std::vector<dna_trie::string> reads;
+	std::mt19937 rnd{ 42 };
+	for (int j = 0; j < 500; ++j) {
+		dna_trie::string read;
+		for (int k = 0; k < 12; ++k) {
+			read.push_back("ACGT"[rnd() % 4]);
+		}
+		reads.push_back(read);
+	}
+	std::sort(reads.begin(), reads.end());
+	reads.erase(std::unique(reads.begin(), reads.end()), reads.end());
+	dna_trie d{ reads.begin(), reads.end() };
+	ASSERT_EQ(d.size(), reads.size());
+	std::vector<dna_trie::string> expected_c;
+	std::copy_if(reads.begin(), reads.end(), std::back_inserter(expected_c), [](const dna_trie::string &read) {
+		return read[0] == 'C';
+	});
+	ASSERT_EQ(d.complete_suggestions("C"), expected_c);
+	ASSERT_FALSE(d.find_prefix("ACGTN"));
+}
+
+TEST(simd, byte_lower_bound) {
+	alignas(32) unsigned char keys[64] = {};
+	for (int j = 0; j < 40; ++j) {
+		keys[j] = static_cast<unsigned char>(j * 6 + 10);
+	}
+	for (int val = 0; val < 256; ++val) {
+		size_t expected = std::lower_bound(keys, keys + 40, val) - keys;
+		ASSERT_EQ(impl_::byte_lower_bound<impl_::simd_key_block>(keys, 40, static_cast<unsigned char>(val)), expected);
+		ASSERT_EQ(impl_::byte_lower_bound<16>(keys, 40, static_cast<unsigned char>(val)), expected);
+		ASSERT_EQ(impl_::byte_lower_bound<1>(keys, 40, static_cast<unsigned char>(val)), expected);
+	}
+}
+
+TEST(frozen_trie, matches_trie) {
+	trie<char, 255U, std::char_traits<char>, impl_::default_vector_storage, impl_::unordered_vector_accessor> t;
+	for (auto &s : words) {
+		t.add(s);
+	}
+	t.add("amo");
+	t.add("ami");
+
+	frozen_trie f{ t };
+	ASSERT_EQ(f.size(), t.size());
+	for (auto &s : words) {
+		ASSERT_TRUE(f.contains(s));
+	}
+	ASSERT_FALSE(f.contains("brawn"));
+	ASSERT_NE(f.find_prefix("brawn"), f.npos);
+	ASSERT_EQ(f.find_prefix("brawl"), f.npos);
+
+	std::vector<std::string> expected_a{
+		"afterthought",
+		"alike",
+		"ami",
+		"amo",
+		"apologise"
+	};
+	ASSERT_EQ(f.complete_suggestions("a"), expected_a);
+	ASSERT_EQ(f.complete_suggestions("ja"), std::vector<std::string>{ "jail" });
+	ASSERT_EQ(f.closest_matches("ame").size(), 2);
+	ASSERT_EQ(f.closest_matches("tigar"), std::vector<std::string>{ "tiger" });
+}
+
+static constexpr const char *http_methods[] = {
+	"GET", "HEAD", "POST", "PUT", "DELETE", "CONNECT", "OPTIONS", "TRACE", "PATCH", "GET"
+};
+
+TEST(static_trie, matches_trie) {
+	constexpr auto t = make_static_trie<http_methods>();
+	static_assert(t.contains("PATCH") && !t.contains("PAT") && !t.contains("PATCHES"));
+	static_assert(t.find_prefix("PAT") != t.npos && t.find_prefix("PET") == t.npos);
+	static_assert(t.size() == 9);
+
+	trie<char> expected;
+	for (const char *method : http_methods) {
+		expected.add(method);
+	}
+	ASSERT_EQ(t.node_count(), count_nodes(*expected.find_prefix("")));
+	for (const char *method : http_methods) {
+		ASSERT_TRUE(t.contains(method));
+	}
+	ASSERT_EQ(t.complete_suggestions("P"), expected.complete_suggestions("P"));
+	ASSERT_EQ(t.closest_matches("PUSH"), expected.closest_matches("PUSH"));
+	ASSERT_EQ(t.value(t.find_prefix("CON", true)), 'N');
+	ASSERT_EQ(t.find_prefix("COPY", true), t.find_prefix("CO"));
+}
+
+TEST(dawg, matches_trie) {
+	// Four keys, one state per distinct suffix set: root, t, then a and o
+	// share the state before p, p is final and shares the final s state.
+	std::vector<std::string> small{ "tap", "taps", "top", "tops" };
+	dawg<char> d{ small.begin(), small.end() };
+	ASSERT_EQ(d.size(), 4U);
+	ASSERT_EQ(d.state_count(), 5U);
+	ASSERT_EQ(d.edge_count(), 5U);
+	ASSERT_EQ(d.complete_suggestions(""), small);
+	ASSERT_TRUE(d.contains("tops"));
+	ASSERT_FALSE(d.contains("to"));
+	ASSERT_FALSE(d.contains("tapss"));
+
+	std::vector<std::string> keys = words;
+	for (auto &w : words) {
+		keys.push_back(w + "s");
+		keys.push_back("un" + w);
+		keys.push_back(w);
+	}
+	std::sort(keys.begin(), keys.end());
+	dawg<char> large{ keys.begin(), keys.end() };
+	keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+	trie<char> expected{ keys.begin(), keys.end() };
+	ASSERT_EQ(large.size(), keys.size());
+	ASSERT_LT(large.state_count(), count_nodes(*expected.find_prefix("")));
+	ASSERT_EQ(large.complete_suggestions(""), keys);
+	for (const char *prefix : { "t", "un", "unt", "tigers", "x" }) {
+		ASSERT_EQ(large.complete_suggestions(prefix), expected.complete_suggestions(prefix));
+	}
+	for (const char *query : { "tenth", "unteeth", "brik", "skins" }) {
+		ASSERT_EQ(large.closest_matches(query, 1), expected.closest_matches(query, 1));
+		ASSERT_EQ(large.closest_matches(query, 2, true), expected.closest_matches(query, 2, true));
+	}
+
+	std::vector<std::string> unsorted{ "b", "a" };
+	ASSERT_THROW((dawg<char>{ unsorted.begin(), unsorted.end() }), std::invalid_argument);
+	ASSERT_TRUE(dawg<char>{}.complete_suggestions("").empty());
+}
+
+TEST(mapped_trie, save_and_open) {
+	trie<char> t;
+	for (auto &s : words) {
+		t.add(s);
+	}
+	const std::string path = "mapped_trie_test.bin";
+	t.save(path);
+
+	{
+		auto m = mapped_trie<char>::open(path);
+		ASSERT_EQ(m.size(), t.size());
+		ASSERT_EQ(m.node_count(), frozen_trie{ t }.node_count());
+		for (auto &s : words) {
+			ASSERT_TRUE(m.contains(s));
+		}
+		ASSERT_FALSE(m.contains("brawn"));
+		ASSERT_EQ(m.complete_suggestions("a"), t.complete_suggestions("a"));
+		ASSERT_EQ(m.closest_matches("tigar"), std::vector<std::string>{ "tiger" });
+		ASSERT_THROW(mapped_trie<char16_t>::open(path), std::runtime_error);
+
+		// Saving replaces the file instead of rewriting it, so the mapping
+		// still sees the old trie.
+		trie<char> other;
+		other.add("other");
+		other.save(path);
+		ASSERT_TRUE(m.contains("tiger"));
+		ASSERT_EQ(mapped_trie<char>::open(path).size(), 1U);
+		for (auto &entry : std::filesystem::directory_iterator{ "." }) {
+			ASSERT_NE(entry.path().extension(), ".tmp");
+		}
+		t.save(path);
+	}
+
+	// A child offset pointing past the end of the node array.
+	{
+		auto layout = impl_::flat_trie_layout::of<char>(frozen_trie{ t }.node_count());
+		std::fstream file{ path, std::ios::binary | std::ios::in | std::ios::out };
+		std::uint32_t offset = 0xFFFFFF00;
+		file.seekp(layout.first_child + 3 * sizeof(offset));
+		file.write(reinterpret_cast<const char *>(&offset), sizeof(offset));
+	}
+	ASSERT_THROW(mapped_trie<char>::open(path), std::runtime_error);
+	std::remove(path.c_str());
+	ASSERT_THROW(mapped_trie<char>::open(path), std::runtime_error);
+}
+
+TEST(aho_corasick, scan) {
+	trie<char> t;
+	for (auto s : { "he", "she", "his", "hers", "s" }) {
+		t.add(s);
+	}
+	aho_corasick ac{ t };
+
+	using result = std::vector<std::pair<size_t, std::string_view>>;
+	ASSERT_EQ(ac.find_all("ushers"), (result{ { 1, "s" }, { 1, "she" }, { 2, "he" }, { 2, "hers" }, { 5, "s" } }));
+	ASSERT_EQ(ac.find_all("xyz"), result{});
+
+	// Chunk boundaries fall inside matches; positions count from the start.
+	result chunked;
+	auto collect = [&](size_t pos, std::string_view match) {
+		chunked.emplace_back(pos, match);
+	};
+	aho_corasick<char>::scanner scanner{ ac };
+	for (std::string_view chunk : { "ush", "e", "", "rs his" }) {
+		scanner.feed(chunk, collect);
+	}
+	ASSERT_EQ(scanner.position(), 10);
+	ASSERT_EQ(chunked, ac.find_all("ushers his"));
+	ASSERT_EQ(chunked[3], (std::pair<size_t, std::string_view>{ 2, "hers" }));
+}
+
+TEST(radix_trie, add_suggestions) {
+	radix_trie<char> t;
+	for (auto &s : words) {
+		t.add(s);
+	}
+	ASSERT_EQ(t.size(), words.size());
+
+	// Splitting "tangy" and "tent" must not lose either key.
+	t.add("tan");
+	t.add("tan");
+	ASSERT_EQ(t.size(), words.size() + 1);
+	ASSERT_TRUE(t.contains("tan"));
+	ASSERT_TRUE(t.contains("tangy"));
+	ASSERT_TRUE(t.contains("tent"));
+	ASSERT_FALSE(t.contains("ta"));
+	ASSERT_FALSE(t.contains("tangys"));
+
+	std::vector<std::string> expected_t{
+		"tan",
+		"tangy",
+		"teeth",
+		"tent",
+		"tiger",
+		"treat"
+	};
+	ASSERT_EQ(t.complete_suggestions("t"), expected_t);
+	ASSERT_EQ(t.complete_suggestions("comp"), std::vector<std::string>{ "comparison" });
+	ASSERT_EQ(t.complete_suggestions("compare").size(), 0);
+	ASSERT_NE(t.find_prefix("compar"), nullptr);
+	ASSERT_EQ(t.closest_matches("tigar"), std::vector<std::string>{ "tiger" });
+}
+
+TEST(radix_trie, collapses_single_child_chains) {
+	radix_trie<char, std::char_traits<char>, impl_::default_set_storage, impl_::default_set_storage_accessor> t;
+	t.add("romane");
+	t.add("romanus");
+	t.add("romulus");
+	t.add("rubens");
+
+	// root, r, om, an, e, us, ulus, ubens
+	ASSERT_EQ(t.node_count(), 8);
+	std::vector<std::string> expected{
+		"romane",
+		"romanus",
+		"romulus"
+	};
+	ASSERT_EQ(t.complete_suggestions("ro"), expected);
+}
+
+TEST(scored_trie, top_k_completions) {
+	scored_trie<char> t;
+	for (size_t j = 0; j < words.size(); ++j) {
+		t.add(words[j], static_cast<unsigned>(j));
+	}
+	ASSERT_EQ(t.size(), words.size());
+	ASSERT_EQ(t.weight("tiger"), 4u);
+	ASSERT_FALSE(t.weight("tig").has_value());
+
+	using result = std::vector<std::pair<std::string, unsigned>>;
+	ASSERT_EQ(t.top_k_completions("t", 2), (result{ { "teeth", 41 }, { "tent", 29 } }));
+	ASSERT_EQ(t.top_k_completions("a", 5), (result{ { "apologise", 35 }, { "alike", 7 }, { "afterthought", 1 } }));
+	ASSERT_EQ(t.top_k_completions("x", 5).size(), 0);
+
+	// Lowering the heaviest key must lower the cached maximum with it.
+	t.add("teeth", 0);
+	t.add("tangy", 100);
+	ASSERT_EQ(t.size(), words.size());
+	ASSERT_EQ(t.top_k_completions("t", 3), (result{ { "tangy", 100 }, { "tent", 29 }, { "treat", 27 } }));
+	ASSERT_EQ(t.find_prefix("te")->max_weight(), 29u);
+	ASSERT_EQ(t.top_k_completions("", 1), (result{ { "tangy", 100 } }));
+}
+
+TEST(trie_map, insert_find_prefix) {
+	trie_map<char, int> m;
+	for (size_t j = 0; j < words.size(); ++j) {
+		ASSERT_TRUE(m.insert_or_assign(words[j], static_cast<int>(j)).second);
+	}
+	ASSERT_EQ(m.size(), words.size());
+	ASSERT_EQ(*m.find("tiger"), 4);
+	ASSERT_EQ(m.find("tig"), nullptr);
+	ASSERT_EQ(m.find("tigers"), nullptr);
+
+	auto assigned = m.insert_or_assign("tiger", 40);
+	ASSERT_FALSE(assigned.second);
+	ASSERT_EQ(*assigned.first, 40);
+	ASSERT_EQ(m.size(), words.size());
+
+	std::vector<std::pair<std::string, int>> expected_t{
+		{ "tangy", 8 }, { "teeth", 41 }, { "tent", 29 }, { "tiger", 40 }, { "treat", 27 }
+	};
+	std::vector<std::pair<std::string, int>> actual;
+	for (auto [key, value] : m.with_prefix("t")) {
+		actual.emplace_back(key, value);
+	}
+	ASSERT_EQ(actual, expected_t);
+
+	for (auto [key, value] : m.with_prefix("te")) {
+		value = -1;
+	}
+	ASSERT_EQ(*m.find("tent"), -1);
+
+	const auto &cm = m;
+	auto range = cm.with_prefix("zz");
+	ASSERT_TRUE(range.begin() == range.end());
+}
+
+TEST(concurrent_trie, add_remove) {
+	concurrent_trie<char> t;
+	for (auto &s : words) {
+		t.add(s);
+	}
+	t.add("tan");
+	ASSERT_EQ(t.size(), words.size() + 1);
+	ASSERT_TRUE(t.contains("tangy"));
+	ASSERT_TRUE(t.contains("tan"));
+	ASSERT_FALSE(t.contains("ta"));
+
+	t.remove("tangy");
+	t.remove("tangy");
+	ASSERT_EQ(t.size(), words.size());
+	ASSERT_FALSE(t.contains("tangy"));
+	ASSERT_TRUE(t.contains("tan"));
+
+	std::vector<std::string> expected_a{
+		"afterthought",
+		"alike",
+		"apologise"
+	};
+	ASSERT_EQ(t.complete_suggestions("a"), expected_a);
+	ASSERT_EQ(t.complete_suggestions("tan"), std::vector<std::string>{ "tan" });
+}
+
+TEST(concurrent_trie, readers_during_writes) {
+	concurrent_trie<char> t;
+	for (auto &s : words) {
+		t.add(s);
+	}
+
+	std::atomic<bool> done{ false };
+	std::atomic<size_t> failures{ 0 };
+	std::vector<std::thread> readers;
+	for (int j = 0; j < 4; ++j) {
+		readers.emplace_back([&] {
+			while (!done) {
+				// Keys that are never touched by the writer stay visible.
+				if (!t.contains("jail") || t.complete_suggestions("a").size() < 3) ++failures;
+			}
+		});
+	}
+
+	for (int round = 0; round < 200; ++round) {
+		std::string key = "a" + std::to_string(round);
+		t.add(key);
+		if (round % 2) t.remove(key);
+	}
+	done = true;
+	for (auto &reader : readers) {
+		reader.join();
+	}
+
+	ASSERT_EQ(failures, 0);
+	ASSERT_EQ(t.size(), words.size() + 100);
+	ASSERT_TRUE(t.contains("a198"));
+	ASSERT_FALSE(t.contains("a199"));
+}
+
+TEST(concurrent_insert_trie, concurrent_writers) {
+	concurrent_insert_trie<char> t;
+	std::vector<std::thread> writers;
+	std::atomic<size_t> inserted{ 0 };
+	for (int j = 0; j < 4; ++j) {
+		writers.emplace_back([&, j] {
+			// Every writer inserts the shared words plus keys of its own.
+			for (auto &s : words) {
+				if (t.add(s)) ++inserted;
+			}
+			for (int k = 0; k < 500; ++k) {
+				if (t.add("k" + std::to_string(k * 4 + j))) ++inserted;
+			}
+		});
+	}
+	for (auto &writer : writers) {
+		writer.join();
+	}
+
+	ASSERT_EQ(inserted, words.size() + 2000);
+	ASSERT_EQ(t.size(), words.size() + 2000);
+	ASSERT_TRUE(t.contains("k1999"));
+	ASSERT_FALSE(t.contains("k2000"));
+	ASSERT_FALSE(t.add("tangy"));
+
+	std::vector<std::string> expected_a{
+		"afterthought",
+		"alike",
+		"apologise"
+	};
+	ASSERT_EQ(t.complete_suggestions("a"), expected_a);
+}
+
+TEST(concurrent_insert_trie, wide_nodes) {
+	// Every byte value below the root and below "a", so that both nodes
+	// switch to an index while the writers are still linking children in.
+	std::vector<std::string> keys;
+	for (int c = 0; c < 256; ++c) {
+		keys.emplace_back(1, static_cast<char>(c));
+		keys.push_back(std::string{ "a" } + static_cast<char>(c));
+	}
+
+	concurrent_insert_trie<char> t;
+	std::vector<std::thread> writers;
+	for (int j = 0; j < 4; ++j) {
+		writers.emplace_back([&, j] {
+			for (size_t k = 0; k < keys.size(); ++k) {
+				t.add(keys[(k * 7 + j * 131) % keys.size()]);
+			}
+		});
+	}
+	for (auto &writer : writers) {
+		writer.join();
+	}
+
+	std::sort(keys.begin(), keys.end());
+	keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+	ASSERT_EQ(t.size(), keys.size());
+	for (auto &s : keys) {
+		ASSERT_TRUE(t.contains(s));
+		ASSERT_FALSE(t.add(s));
+	}
+	ASSERT_FALSE(t.contains("ab\xff"));
+	ASSERT_EQ(t.complete_suggestions(""), keys);
+	ASSERT_TRUE(t.add("ab\xff"));
+	ASSERT_EQ(t.complete_suggestions("ab"), (std::vector<std::string>{ "ab", "ab\xff" }));
+}
 
 #ifdef EXPERIMENTAL_CORO
 TEST(trie, coro) {
@@ -249,6 +1301,8 @@ int main(int argc, char *argv[]) {
 	testing::InitGoogleTest(&argc, argv);
 	int res = RUN_ALL_TESTS();
 
+#ifdef _WIN32
 	system("PAUSE");
+#endif
 	return res;
 }
\ No newline at end of file
@@ -7,7 +7,33 @@
 #include <memory>
 #include <type_traits>
 #include <string_view>
+#include <limits>
+#include <cstdint>
+#include <cstddef>
+#include <new>
+#include <iterator>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <exception>
+#include <system_error>
+#include <stdexcept>
+#include <array>
+#include <utility>
+
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define TRIE_SIMD_AVX2_ 1
+#define TRIE_SIMD_SSE2_ 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TRIE_SIMD_SSE2_ 1
+#endif
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 #ifdef EXPERIMENTAL_CORO
 #include <experimental\coroutine>
@@ -16,6 +42,92 @@
 
 namespace impl_
 {
+// Asks for the cache line holding p ahead of its use. Only a hint: it never
+// faults, whatever p points to.
+inline void prefetch(const void *p) {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	_mm_prefetch(static_cast<const char *>(p), _MM_HINT_T0);
+#elif defined(__GNUC__)
+	__builtin_prefetch(p);
+#endif
+}
+
+template <class T, class = void>
+struct has_data : std::false_type {};
+
+template <class T>
+struct has_data<T, std::void_t<decltype(std::declval<const T &>().data())>> : std::true_type {};
+
+inline size_t popcount64(std::uint64_t bits) {
+#if defined(_MSC_VER) && defined(_M_X64)
+	return static_cast<size_t>(__popcnt64(bits));
+#elif defined(_MSC_VER)
+	return static_cast<size_t>(__popcnt(static_cast<std::uint32_t>(bits)) + __popcnt(static_cast<std::uint32_t>(bits >> 32)));
+#else
+	return static_cast<size_t>(__builtin_popcountll(bits));
+#endif
+}
+
+inline size_t trailing_ones(std::uint32_t mask) {
+#if defined(_MSC_VER)
+	unsigned long index;
+	return _BitScanForward(&index, ~mask) ? index : 32;
+#else
+	return ~mask ? __builtin_ctz(~mask) : 32;
+#endif
+}
+
+// Width, in bytes, of the widest vector compare available. Byte key arrays
+// searched with byte_lower_bound are padded to a multiple of it.
+#if defined(TRIE_SIMD_AVX2_)
+constexpr size_t simd_key_block = 32;
+#elif defined(TRIE_SIMD_SSE2_)
+constexpr size_t simd_key_block = 16;
+#else
+constexpr size_t simd_key_block = 1;
+#endif
+
+// Number of keys among the first n of a sorted byte array that are smaller
+// than val. Keys are compared as unsigned bytes, a whole block at a time, so
+// the array must be readable up to the next multiple of Block.
+template <size_t Block>
+size_t byte_lower_bound(const unsigned char *keys, size_t n, unsigned char val) {
+	size_t pos = 0;
+#if defined(TRIE_SIMD_AVX2_)
+	if constexpr (Block % 32 == 0) {
+		// There is no unsigned byte compare: flip the sign bits instead.
+		const __m256i bias = _mm256_set1_epi8(static_cast<char>(0x80));
+		const __m256i needle = _mm256_xor_si256(_mm256_set1_epi8(static_cast<char>(val)), bias);
+		for (size_t j = 0; j < n; j += 32) {
+			__m256i block = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(keys + j)), bias);
+			auto mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpgt_epi8(needle, block)));
+			if (n - j < 32) mask &= (std::uint32_t{ 1 } << (n - j)) - 1;
+			// Keys are sorted, so the smaller ones form a prefix of the block.
+			size_t count = trailing_ones(mask);
+			pos += count;
+			if (count < 32) break;
+		}
+		return pos;
+	}
+#endif
+#if defined(TRIE_SIMD_SSE2_)
+	if constexpr (Block % 16 == 0) {
+		const __m128i bias = _mm_set1_epi8(static_cast<char>(0x80));
+		const __m128i needle = _mm_xor_si128(_mm_set1_epi8(static_cast<char>(val)), bias);
+		for (size_t j = 0; j < n; j += 16) {
+			__m128i block = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(keys + j)), bias);
+			auto mask = static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmplt_epi8(block, needle)));
+			if (n - j < 16) mask &= (std::uint32_t{ 1 } << (n - j)) - 1;
+			size_t count = trailing_ones(mask);
+			pos += count;
+			if (count < 16) break;
+		}
+		return pos;
+	}
+#endif
+	return std::lower_bound(keys, keys + n, val) - keys;
+}
+
 template <class RecursiveNode, class ValueT, class ValueTraits>
 class default_set_storage
 {
@@ -49,6 +161,42 @@ protected:
 	storage_t storage_;
 };
 
+template <class StorageIt, class RecursiveNode>
+struct vector_node_iterator
+{
+	using iterator_category = std::forward_iterator_tag;
+	using value_type = RecursiveNode;
+	using reference = value_type &;
+	using pointer = value_type *;
+	using storage_it = StorageIt;
+
+	vector_node_iterator(storage_it it) : it_(it) {}
+
+
+	reference operator*() {
+		return *it_->node();
+	}
+
+	reference operator->() {
+		return *it_->node();
+	}
+
+	vector_node_iterator &operator++ () {
+		++it_;
+		return *this;
+	}
+
+	bool operator==(const vector_node_iterator &rhs) const {
+		return it_ == rhs.it_;
+	}
+
+	bool operator!=(const vector_node_iterator &rhs) const {
+		return it_ != rhs.it_;
+	}
+private:
+	storage_it it_;
+};
+
 template <class RecursiveNode, class ValueT, class ValueTraits>
 class default_vector_storage
 {
@@ -77,51 +225,231 @@ public:
 	using pointer = value_type *;
 	using traits = ValueTraits;
 
-	struct node_iterator
-	{
-		using iterator_category = std::forward_iterator_tag;
-		using value_type = node_type;
-		using reference = value_type &;
-		using pointer = value_type *;
-		using storage_it = typename storage_t::iterator;
+	using node_iterator = vector_node_iterator<typename storage_t::iterator, node_type>;
 
-		node_iterator(storage_it it) : it_(it) {}
+	node_iterator begin() { return { storage_.begin() }; }
+	node_iterator end() { return { storage_.end() }; }
+protected:
+	// Removes a child together with its whole subtrie.
+	void erase_entry(typename storage_t::iterator pos) {
+		storage_.erase(pos);
+	}
 
+	storage_t storage_;
+};
 
-		reference operator*() {
-			return *it_->node();
-		}
+// Bump allocator that carves nodes and child vectors out of large blocks.
+// Released chunks are kept on per-size free lists and handed out again, and
+// the blocks themselves are only returned to the system when the arena dies.
+class node_arena
+{
+public:
+	static constexpr size_t block_size = 64 * 1024;
+	static constexpr size_t granularity = alignof(std::max_align_t);
+
+	node_arena() = default;
+	node_arena(const node_arena &) = delete;
+	node_arena &operator=(const node_arena &) = delete;
+
+	~node_arena() {
+		for (void *block : blocks_) ::operator delete(block);
+	}
 
-		reference operator->() {
-			return *it_->node();
+	void *allocate(size_t bytes) {
+		bytes = round_up_(bytes);
+		size_t cls = bytes / granularity;
+		if (cls < free_lists_.size() && free_lists_[cls]) {
+			free_chunk *chunk = free_lists_[cls];
+			free_lists_[cls] = chunk->next;
+			return chunk;
 		}
 
-		node_iterator &operator++ () {
-			++it_;
-			return *this;
+		// Oversized requests get a block of their own.
+		if (bytes > block_size / 4) return new_block_(bytes);
+
+		if (static_cast<size_t>(end_ - cur_) < bytes) {
+			cur_ = static_cast<char *>(new_block_(block_size));
+			end_ = cur_ + block_size;
 		}
+		void *result = cur_;
+		cur_ += bytes;
+		return result;
+	}
 
-		bool operator==(const node_iterator &rhs) const {
-			return it_ == rhs.it_;
+	void deallocate(void *p, size_t bytes) {
+		size_t cls = round_up_(bytes) / granularity;
+		// Oversized blocks are not worth tracking; they go with the arena.
+		if (cls > max_class_) return;
+		if (cls >= free_lists_.size()) free_lists_.resize(cls + 1, nullptr);
+		free_lists_[cls] = ::new (p) free_chunk{ free_lists_[cls] };
+	}
+
+	template <class T, class... Ts>
+	T *create(Ts && ...args) {
+		return ::new (allocate(sizeof(T))) T(std::forward<Ts>(args)...);
+	}
+
+	template <class T>
+	void destroy(T *p) {
+		p->~T();
+		deallocate(p, sizeof(T));
+	}
+
+	size_t bytes_reserved() const {
+		return reserved_;
+	}
+
+private:
+	struct free_chunk
+	{
+		free_chunk *next;
+	};
+
+	static constexpr size_t max_class_ = block_size / 4 / granularity;
+
+	static size_t round_up_(size_t bytes) {
+		return bytes == 0 ? granularity : (bytes + granularity - 1) / granularity * granularity;
+	}
+
+	void *new_block_(size_t bytes) {
+		blocks_.push_back(nullptr);
+		blocks_.back() = ::operator new(bytes);
+		reserved_ += bytes;
+		return blocks_.back();
+	}
+
+	std::vector<void *> blocks_;
+	std::vector<free_chunk *> free_lists_;
+	char *cur_ = nullptr;
+	char *end_ = nullptr;
+	size_t reserved_ = 0;
+};
+
+template <class T>
+class arena_allocator
+{
+public:
+	using value_type = T;
+
+	explicit arena_allocator(node_arena *arena) noexcept : arena_(arena) {}
+
+	template <class U>
+	arena_allocator(const arena_allocator<U> &other) noexcept : arena_(other.arena()) {}
+
+	T *allocate(size_t n) {
+		return static_cast<T *>(arena_->allocate(n * sizeof(T)));
+	}
+
+	void deallocate(T *p, size_t n) noexcept {
+		arena_->deallocate(p, n * sizeof(T));
+	}
+
+	// Elements that know about allocators (the arena storage pairs) receive
+	// this one, so that whole subtries end up in the same arena.
+	template <class U, class... Ts>
+	void construct(U *p, Ts && ...args) {
+		if constexpr (std::uses_allocator_v<U, arena_allocator>)
+			::new (static_cast<void *>(p)) U(std::allocator_arg, *this, std::forward<Ts>(args)...);
+		else
+			::new (static_cast<void *>(p)) U(std::forward<Ts>(args)...);
+	}
+
+	node_arena *arena() const noexcept {
+		return arena_;
+	}
+
+	template <class U>
+	bool operator==(const arena_allocator<U> &rhs) const noexcept {
+		return arena_ == rhs.arena();
+	}
+
+	template <class U>
+	bool operator!=(const arena_allocator<U> &rhs) const noexcept {
+		return arena_ != rhs.arena();
+	}
+
+private:
+	node_arena *arena_;
+};
+
+// Same layout as default_vector_storage, but every node and child vector is
+// allocated from the node_arena owned by the trie. Nodes are only destroyed
+// individually when they are removed from the trie; otherwise the arena
+// releases them all at once.
+template <class RecursiveNode, class ValueT, class ValueTraits>
+class arena_vector_storage
+{
+	struct storage_pair;
+public:
+	using arena_type = node_arena;
+	using allocator_type = arena_allocator<storage_pair>;
+
+private:
+	struct storage_pair
+	{
+		using allocator_type = arena_vector_storage::allocator_type;
+
+		template <class... Ts>
+		storage_pair(std::allocator_arg_t, const allocator_type &alloc, ValueT val, Ts && ...args) :
+			node_(alloc.arena()->template create<RecursiveNode>(std::allocator_arg, alloc, val, std::forward<Ts>(args)...)),
+			value_(val)
+		{}
+
+		storage_pair(std::allocator_arg_t, const allocator_type &, storage_pair &&other) noexcept :
+			node_(other.node_), value_(other.value_)
+		{}
+
+		storage_pair(storage_pair &&) noexcept = default;
+		storage_pair &operator=(storage_pair &&) noexcept = default;
+
+		ValueT value() const {
+			return value_;
 		}
 
-		bool operator!=(const node_iterator &rhs) const {
-			return it_ != rhs.it_;
+		RecursiveNode *node() {
+			return node_;
 		}
-	private:
-		storage_it it_;
+
+		RecursiveNode *node_;
+		ValueT value_;
 	};
+public:
+	using node_type = RecursiveNode;
+	using entry_type = storage_pair;
+	using storage_t = std::vector<entry_type, allocator_type>;
+	using value_type = ValueT;
+	using pointer = value_type *;
+	using traits = ValueTraits;
+	using node_iterator = vector_node_iterator<typename storage_t::iterator, node_type>;
+
+	explicit arena_vector_storage(const allocator_type &alloc) : storage_(alloc) {}
 
 	node_iterator begin() { return { storage_.begin() }; }
 	node_iterator end() { return { storage_.end() }; }
 protected:
+	// Removes a child together with its whole subtrie, returning the memory
+	// to the arena's free lists.
+	void erase_entry(typename storage_t::iterator pos) {
+		destroy_subtree_(storage_.get_allocator().arena(), pos->node_);
+		storage_.erase(pos);
+	}
+
 	storage_t storage_;
+
+private:
+	static void destroy_subtree_(node_arena *arena, RecursiveNode *n) {
+		for (const storage_pair &entry : n->raw_storage()) {
+			destroy_subtree_(arena, entry.node_);
+		}
+		arena->destroy(n);
+	}
 };
 
 template <class StorageT>
 class default_vector_accessor : private StorageT
 {
 public:
+	using StorageT::StorageT;
 	using StorageT::begin;
 	using StorageT::end;
 	using storage_t = typename StorageT::storage_t;
@@ -134,7 +462,7 @@ public:
 	using node_iterator = typename StorageT::node_iterator;
 
 	typename storage_t::iterator find_pos(value_type val) {
-		return std::lower_bound(storage_.begin(), storage_.end(), val, [](const entry_type &lhs, value_type rhs) {
+		return std::lower_bound(this->storage_.begin(), this->storage_.end(), val, [](const entry_type &lhs, value_type rhs) {
 			return traits::lt(lhs.value(), rhs);
 		});
 	}
@@ -153,7 +481,7 @@ public:
 	node_iterator get(value_type val) {
 		auto pos = this->find_pos(val);
 
-		if (pos == storage_.end() || pos->value() != val) return this->end();
+		if (pos == this->storage_.end() || pos->value() != val) return this->end();
 
 		return pos;
 	}
@@ -162,13 +490,35 @@ public:
 	// Parameter pack contains all the arguments needed for the node constructor
 	node_iterator get_or_emplace(value_type val, Ts && ...args) {
 		auto pos = this->find_pos(val);
-		if (pos == storage_.end() || pos->value() != val) 
+		if (pos == this->storage_.end() || pos->value() != val) 
 			return emplace_hint(pos, std::forward<Ts>(args)...);
 
 		return pos;
 	}
 
-	//void remove();
+	void reserve(size_t count) {
+		this->storage_.reserve(count);
+	}
+
+	// Adds a child that orders after all the existing ones, without searching.
+	template <class... Ts>
+	node_iterator append(value_type val, Ts && ...args) {
+		this->storage_.emplace_back(val, std::forward<Ts>(args)...);
+		return this->storage_.end() - 1;
+	}
+
+	// Removes the child holding val, if any, with its subtrie. The vector
+	// gives memory back once it is mostly empty.
+	void remove(value_type val) {
+		auto pos = this->find_pos(val);
+		if (pos == this->storage_.end() || pos->value() != val) return;
+		this->erase_entry(pos);
+		if (this->storage_.size() <= this->storage_.capacity() / 4) shrink_to_fit();
+	}
+
+	void shrink_to_fit() {
+		this->storage_.shrink_to_fit();
+	}
 
 	// FIXME this is a temporary solution for testing purposes only.
 	auto get_elements() const{
@@ -194,7 +544,12 @@ public:
 	}
 
 	auto &raw_storage() const {
-		return storage_;
+		return this->storage_;
+	}
+
+	// Exchanges the whole set of children with another node.
+	void swap_children(default_vector_accessor &other) {
+		this->storage_.swap(other.storage_);
 	}
 
 };
@@ -203,6 +558,7 @@ template <class StorageT>
 class unordered_vector_accessor : private StorageT
 {
 public:
+	using StorageT::StorageT;
 	using StorageT::begin;
 	using StorageT::end;
 	using storage_t = typename StorageT::storage_t;
@@ -215,7 +571,7 @@ public:
 	using node_iterator = typename StorageT::node_iterator;
 
 	typename storage_t::iterator find_pos(value_type val) {
-		return std::find_if(storage_.begin(), storage_.end(), [=](const entry_type &lhs) {
+		return std::find_if(this->storage_.begin(), this->storage_.end(), [=](const entry_type &lhs) {
 			return traits::eq(lhs.value(), val);
 		});
 	}
@@ -234,13 +590,35 @@ public:
 	// Parameter pack contains all the arguments needed for the node constructor
 	node_iterator get_or_emplace(value_type val, Ts && ...args) {
 		auto pos = this->find_pos(val);
-		if (pos == storage_.end())
+		if (pos == this->storage_.end())
 			return emplace(std::forward<Ts>(args)...);
 
 		return pos;
 	}
 
-	//void remove();
+	void reserve(size_t count) {
+		this->storage_.reserve(count);
+	}
+
+	template <class... Ts>
+	node_iterator append(value_type val, Ts && ...args) {
+		return emplace(val, std::forward<Ts>(args)...);
+	}
+
+	// Removes the child holding val, if any, with its subtrie. The last
+	// child takes its place.
+	void remove(value_type val) {
+		auto pos = this->find_pos(val);
+		if (pos == this->storage_.end()) return;
+		auto last = this->storage_.end() - 1;
+		if (pos != last) std::iter_swap(pos, last);
+		this->erase_entry(last);
+		if (this->storage_.size() <= this->storage_.capacity() / 4) shrink_to_fit();
+	}
+
+	void shrink_to_fit() {
+		this->storage_.shrink_to_fit();
+	}
 
 	// FIXME this is a temporary solution for testing purposes only.
 	auto get_elements() const {
@@ -266,7 +644,12 @@ public:
 
 
 	auto &raw_storage() const {
-		return storage_;
+		return this->storage_;
+	}
+
+	// Exchanges the whole set of children with another node.
+	void swap_children(unordered_vector_accessor &other) {
+		this->storage_.swap(other.storage_);
 	}
 
 };
@@ -275,6 +658,7 @@ template <class StorageT>
 class default_set_storage_accessor : private StorageT
 {
 public:
+	using StorageT::StorageT;
 	using StorageT::begin;
 	using StorageT::end;
 	using storage_t = typename StorageT::storage_t;
@@ -290,7 +674,7 @@ public:
 	}
 
 	node_iterator get(value_type val) {
-		return storage_.find(val);
+		return this->storage_.find(val);
 	}
 
 	// We know that for std::set, this is equivalent to an emplace function.
@@ -299,10 +683,22 @@ public:
 		return emplace(std::forward<Ts>(args)...);
 	}
 
-	void remove(value_type val) {
+	void reserve(size_t) {}
+
+	// Adds a child that orders after all the existing ones.
+	template <class... Ts>
+	node_iterator append(value_type val, Ts && ...args) {
+		return this->storage_.emplace_hint(this->storage_.end(), val, std::forward<Ts>(args)...);
+	}
 
+	void remove(value_type val) {
+		auto pos = this->storage_.find(val);
+		if (pos != this->storage_.end()) this->storage_.erase(pos);
 	}
 
+	// Tree nodes are allocated one by one; there is nothing to give back.
+	void shrink_to_fit() {}
+
 	storage_t &get_elements() {
 		return this->storage_;
 	}
@@ -310,166 +706,1586 @@ public:
 	const storage_t &get_elements() const {
 		return this->storage_;
 	}
+
+	auto &raw_storage() const {
+		return this->storage_;
+	}
+
+	// Exchanges the whole set of children with another node.
+	void swap_children(default_set_storage_accessor &other) {
+		this->storage_.swap(other.storage_);
+	}
 };
 
-template <
-	class ValueT, 
-	class DepthT, 
-	class ValueTraits, 
-	template <class, class, class> class Storage = impl_::default_vector_storage, 
-	template<class> class Accessor = impl_::default_vector_accessor>
-class node_t : public 
-	Accessor<Storage<node_t<ValueT, DepthT, ValueTraits, Storage, Accessor>, ValueT, ValueTraits>>
+// Child container of an adaptive radix tree node. It starts as a sorted array
+// of 4 children, then grows to 16, then to a 256 byte index over 48 slots and
+// finally to a direct table of 256 children as the fan-out increases. Positions
+// are slot numbers for the sorted kinds and key bytes for the other two.
+template <class RecursiveNode>
+class adaptive_children
 {
-	using StorageT_ = Storage<node_t, ValueT, ValueTraits>;
-	using AccessorT_ = Accessor<Storage<node_t, ValueT, ValueTraits>>;
-
 public:
-	using value_type = ValueT;
-	using depth_type = DepthT;
-	using traits_type = ValueTraits;
-	//using iterator = typename AccessorT_::child_iterator;
-	//using allocator_type = Allocator;
+	enum kind_t : unsigned char { node0, node4, node16, node48, node256 };
+	static constexpr int npos = -1;
 
-	node_t(ValueT ch, node_t *parent, DepthT depth, bool marked = false) :
-		parent_(parent), value_(ch), depth_(depth), height_(0)
-	{
-		marked_ = marked;
-	}
+	adaptive_children() = default;
+	adaptive_children(const adaptive_children &) = delete;
+	adaptive_children &operator=(const adaptive_children &) = delete;
 
-	node_t *emplace_child(ValueT c, bool marked = false) {
-		if (height_ == 0) increase_height();
-		return this->AccessorT_::emplace(c, this, depth_ + 1, marked);
+	~adaptive_children() {
+		clear();
 	}
 
-	node_t *get_or_emplace(ValueT c) {
-		if (height_ == 0) increase_height();
-		return mut_ptr_cast_(std::addressof(*this->AccessorT_::get_or_emplace(c, c, this, depth_ + 1, false)));
+	size_t size() const {
+		return count_;
 	}
 
-	using path_list = std::vector<const node_t *>;
+	bool empty() const {
+		return count_ == 0;
+	}
 
-	path_list paths_to(ValueT v, unsigned min_height_req = 0) const {
-		path_list results;
-		for (auto &node : get_elements()) {
+	kind_t kind() const {
+		return kind_;
+	}
 
-			if (const node_t *n = node.get_child(v)) {
-				if (n->height_ >= min_height_req) {
-					results.push_back(n);
-				}
-			}
+	// Size of the array or table currently holding the children.
+	size_t body_bytes() const {
+		switch (kind_) {
+		case node4: return sizeof(sorted_body<4>);
+		case node16: return sizeof(sorted_body<16>);
+		case node48: return sizeof(indexed_body);
+		case node256: return sizeof(direct_body);
+		default: return 0;
 		}
+	}
 
-		return results;
+	void swap(adaptive_children &other) noexcept {
+		std::swap(body_, other.body_);
+		std::swap(count_, other.count_);
+		std::swap(kind_, other.kind_);
 	}
 
-	void append_paths_to(path_list &results, ValueT v, unsigned min_height_req = 0) const {
-		for (const node_t &node : this->AccessorT::get_elements()) {
-			if (const node_t *n = node.get_child(v)) {
-				if (n->height_ >= min_height_req) {
-					results.push_back(n);
-				}
-			}
+	int find(unsigned char key) const {
+		switch (kind_) {
+		case node4: return find_sorted_(as_<sorted_body<4>>()->keys, key);
+		case node16: {
+			const unsigned char *keys = as_<sorted_body<16>>()->keys;
+			size_t pos = byte_lower_bound<16>(keys, count_, key);
+			return pos < count_ && keys[pos] == key ? static_cast<int>(pos) : npos;
+		}
+		case node48: return as_<indexed_body>()->index[key] ? key : npos;
+		case node256: return as_<direct_body>()->children[key] ? key : npos;
+		default: return npos;
 		}
-
-		return results;
 	}
 
-
-	path_list paths_to2(ValueT v, unsigned min_height_req = 0) const {
-		path_list results;
-		for (const node_t &node : this->AccessorT::get_elements()) {
-			node.append_paths_to(results, v, min_height_req);
-
+	RecursiveNode *at(int pos) const {
+		switch (kind_) {
+		case node4: return as_<sorted_body<4>>()->children[pos];
+		case node16: return as_<sorted_body<16>>()->children[pos];
+		case node48: return as_<indexed_body>()->children[as_<indexed_body>()->index[pos] - 1];
+		default: return as_<direct_body>()->children[pos];
 		}
-
-		return results;
 	}
 
+	int first() const {
+		return kind_ < node48 ? 0 : next(-1);
+	}
 
+	int next(int pos) const {
+		if (kind_ < node48) return pos + 1;
+		while (++pos < 256 && find(static_cast<unsigned char>(pos)) == npos);
+		return pos;
+	}
 
+	int end_pos() const {
+		return kind_ < node48 ? count_ : 256;
+	}
 
-	//void remove_child(ValueT v) {
-	//	children_.erase(children_.find(v));
-	//	if (children_.size() == 0) {
-	//		decrease_height();
-	//	}
-	//}
+	// The key must not be present yet. Returns the position of the child.
+	int insert(unsigned char key, RecursiveNode *child) {
+		switch (kind_) {
+		case node0: grow_to_<sorted_body<4>>(node4); break;
+		case node4: if (count_ == 4) grow_to_<sorted_body<16>>(node16); break;
+		case node16: if (count_ == 16) grow_to_indexed_(); break;
+		case node48: if (count_ == 48) grow_to_direct_(); break;
+		default: break;
+		}
 
-	void mark() {
-		marked_ = 1;
+		++count_;
+		switch (kind_) {
+		case node4: return insert_sorted_(*as_<sorted_body<4>>(), key, child);
+		case node16: return insert_sorted_(*as_<sorted_body<16>>(), key, child);
+		case node48: {
+			indexed_body *body = as_<indexed_body>();
+			body->children[count_ - 1] = child;
+			body->index[key] = static_cast<unsigned char>(count_);
+			return key;
+		}
+		default:
+			as_<direct_body>()->children[key] = child;
+			return key;
+		}
 	}
 
-	void unmark() {
-		marked_ = 0;
+	// Deletes the child stored under key, which must be present. Drops to a
+	// smaller kind once the children fit in well under its capacity.
+	void erase(unsigned char key) {
+		int pos = find(key);
+		delete at(pos);
+		switch (kind_) {
+		case node4: erase_sorted_(*as_<sorted_body<4>>(), pos); break;
+		case node16: erase_sorted_(*as_<sorted_body<16>>(), pos); break;
+		case node48: {
+			indexed_body *body = as_<indexed_body>();
+			int slot = body->index[key] - 1;
+			int last = count_ - 1;
+			// The last slot moves into the hole, so that slots stay dense.
+			if (slot != last) {
+				body->children[slot] = body->children[last];
+				for (int k = 0; k < 256; ++k) {
+					if (body->index[k] == last + 1) {
+						body->index[k] = static_cast<unsigned char>(slot + 1);
+						break;
+					}
+				}
+			}
+			body->index[key] = 0;
+			break;
+		}
+		default:
+			as_<direct_body>()->children[key] = nullptr;
+			break;
+		}
+		--count_;
+
+		switch (kind_) {
+		case node4: if (count_ == 0) shrink_to_fit(); break;
+		case node16: if (count_ <= 2) shrink_to_fit(); break;
+		case node48: if (count_ <= 12) shrink_to_fit(); break;
+		case node256: if (count_ <= 36) shrink_to_fit(); break;
+		default: break;
+		}
 	}
 
-	bool marked() const {
-		return marked_;
+	// Moves the children to the smallest kind that holds them.
+	void shrink_to_fit() {
+		unsigned char keys[256];
+		RecursiveNode *children[256];
+		int count = 0;
+		for (int pos = first(), last = end_pos(); pos != last; pos = next(pos), ++count) {
+			keys[count] = key_at_(pos);
+			children[count] = at(pos);
+		}
+
+		free_body_();
+		reserve(count);
+		for (int j = 0; j < count; ++j) {
+			insert(keys[j], children[j]);
+		}
 	}
 
-	bool leaf() const {
-		return height_ == 0;
+	// Only has an effect on an empty container.
+	void reserve(size_t count) {
+		if (kind_ != node0 || count == 0) return;
+		if (count <= 4) grow_to_<sorted_body<4>>(node4);
+		else if (count <= 16) grow_to_<sorted_body<16>>(node16);
+		else if (count <= 48) grow_to_indexed_();
+		else grow_to_direct_();
 	}
 
-	ValueT value() const {
-		return value_;
+	void clear() {
+		for (int pos = first(), last = end_pos(); pos != last; pos = next(pos)) {
+			delete at(pos);
+		}
+		free_body_();
 	}
 
-	node_t *get_child(ValueT ch) {
-		auto it = this->AccessorT_::get(ch);
-		if (it == this->end()) return nullptr;
+private:
+	template <int N>
+	struct sorted_body
+	{
+		unsigned char keys[N];
+		RecursiveNode *children[N];
+	};
+
+	struct indexed_body
+	{
+		// Slot + 1, or 0 when the key is absent.
+		unsigned char index[256] = {};
+		RecursiveNode *children[48];
+	};
+
+	struct direct_body
+	{
+		RecursiveNode *children[256] = {};
+	};
+
+	template <class Body>
+	Body *as_() const {
+		return static_cast<Body *>(body_);
+	}
+
+	unsigned char key_at_(int pos) const {
+		switch (kind_) {
+		case node4: return as_<sorted_body<4>>()->keys[pos];
+		case node16: return as_<sorted_body<16>>()->keys[pos];
+		default: return static_cast<unsigned char>(pos);
+		}
+	}
+
+	// Releases the body without touching the children.
+	void free_body_() {
+		switch (kind_) {
+		case node4: delete as_<sorted_body<4>>(); break;
+		case node16: delete as_<sorted_body<16>>(); break;
+		case node48: delete as_<indexed_body>(); break;
+		case node256: delete as_<direct_body>(); break;
+		default: break;
+		}
+		body_ = nullptr;
+		count_ = 0;
+		kind_ = node0;
+	}
+
+	template <class Body>
+	void erase_sorted_(Body &body, int pos) {
+		std::copy(body.keys + pos + 1, body.keys + count_, body.keys + pos);
+		std::copy(body.children + pos + 1, body.children + count_, body.children + pos);
+	}
+
+	int find_sorted_(const unsigned char *keys, unsigned char key) const {
+		for (int j = 0; j < count_ && keys[j] <= key; ++j) {
+			if (keys[j] == key) return j;
+		}
+		return npos;
+	}
+
+	template <class Body>
+	int insert_sorted_(Body &body, unsigned char key, RecursiveNode *child) {
+		int pos = count_ - 1;
+		for (; pos > 0 && body.keys[pos - 1] > key; --pos) {
+			body.keys[pos] = body.keys[pos - 1];
+			body.children[pos] = body.children[pos - 1];
+		}
+		body.keys[pos] = key;
+		body.children[pos] = child;
+		return pos;
+	}
+
+	template <class Body>
+	void grow_to_(kind_t kind) {
+		Body *body = new Body{};
+		if (count_) {
+			sorted_body<4> *old = as_<sorted_body<4>>();
+			std::copy(old->keys, old->keys + count_, body->keys);
+			std::copy(old->children, old->children + count_, body->children);
+			delete old;
+		}
+		body_ = body;
+		kind_ = kind;
+	}
+
+	void grow_to_indexed_() {
+		indexed_body *body = new indexed_body;
+		sorted_body<16> *old = as_<sorted_body<16>>();
+		for (int j = 0; j < count_; ++j) {
+			body->index[old->keys[j]] = static_cast<unsigned char>(j + 1);
+			body->children[j] = old->children[j];
+		}
+		delete old;
+		body_ = body;
+		kind_ = node48;
+	}
+
+	void grow_to_direct_() {
+		direct_body *body = new direct_body;
+		indexed_body *old = as_<indexed_body>();
+		for (int key = 0; old && key < 256; ++key) {
+			if (old->index[key]) body->children[key] = old->children[old->index[key] - 1];
+		}
+		delete old;
+		body_ = body;
+		kind_ = node256;
+	}
+
+	void *body_ = nullptr;
+	unsigned short count_ = 0;
+	kind_t kind_ = node0;
+};
+
+// Adaptive radix tree children: the child container resizes itself with the
+// fan-out of the node. Only usable with byte-sized values, which are ordered
+// as unsigned bytes.
+template <class RecursiveNode, class ValueT, class ValueTraits>
+class adaptive_storage
+{
+	static_assert(sizeof(ValueT) == 1, "adaptive_storage indexes children by byte");
+public:
+	using node_type = RecursiveNode;
+	using entry_type = RecursiveNode *;
+	using storage_t = adaptive_children<RecursiveNode>;
+	using value_type = ValueT;
+	using pointer = value_type *;
+	using traits = ValueTraits;
+
+	struct node_iterator
+	{
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = node_type;
+		using reference = value_type &;
+		using pointer = value_type *;
+
+		node_iterator(const storage_t *children, int pos) : children_(children), pos_(pos) {}
+
+		reference operator*() const {
+			return *children_->at(pos_);
+		}
+
+		node_iterator &operator++ () {
+			pos_ = children_->next(pos_);
+			return *this;
+		}
+
+		bool operator==(const node_iterator &rhs) const {
+			return pos_ == rhs.pos_;
+		}
+
+		bool operator!=(const node_iterator &rhs) const {
+			return pos_ != rhs.pos_;
+		}
+	private:
+		const storage_t *children_;
+		int pos_;
+	};
+
+	node_iterator begin() { return { &storage_, storage_.first() }; }
+	node_iterator end() { return { &storage_, storage_.end_pos() }; }
+protected:
+	storage_t storage_;
+};
+
+template <class StorageT>
+class adaptive_accessor : private StorageT
+{
+public:
+	using StorageT::StorageT;
+	using StorageT::begin;
+	using StorageT::end;
+	using storage_t = typename StorageT::storage_t;
+	using value_type = typename StorageT::value_type;
+	using traits = typename StorageT::traits;
+	using node_type = typename StorageT::node_type;
+	using node_pointer = node_type *;
+	using pointer = typename StorageT::pointer;
+	using entry_type = typename StorageT::entry_type;
+	using node_iterator = typename StorageT::node_iterator;
+
+	template <class... Ts>
+	node_iterator emplace(value_type val, Ts && ...args) {
+		return insert_(val, std::make_unique<node_type>(val, std::forward<Ts>(args)...));
+	}
+
+	node_iterator get(value_type val) {
+		int pos = this->storage_.find(key_(val));
+		if (pos == storage_t::npos) return this->end();
+		return { &this->storage_, pos };
+	}
+
+	// Picks the node kind that fits count children straight away.
+	void reserve(size_t count) {
+		this->storage_.reserve(count);
+	}
+
+	// Removes the child holding val, if any, with its subtrie.
+	void remove(value_type val) {
+		if (this->storage_.find(key_(val)) != storage_t::npos) this->storage_.erase(key_(val));
+	}
+
+	void shrink_to_fit() {
+		this->storage_.shrink_to_fit();
+	}
+
+	template <class... Ts>
+	node_iterator append(value_type val, Ts && ...args) {
+		return emplace(val, std::forward<Ts>(args)...);
+	}
+
+	template <class... Ts>
+	// Parameter pack contains all the arguments needed for the node constructor
+	node_iterator get_or_emplace(value_type val, Ts && ...args) {
+		int pos = this->storage_.find(key_(val));
+		if (pos == storage_t::npos)
+			return insert_(val, std::make_unique<node_type>(std::forward<Ts>(args)...));
+
+		return { &this->storage_, pos };
+	}
+
+	struct node_range
+	{
+		node_range(node_iterator beg, node_iterator end) : beg_(beg), end_(end) {}
+
+		node_iterator begin() { return beg_; }
+		node_iterator end() { return end_; }
+
+		node_iterator beg_;
+		node_iterator end_;
+	};
+
+	auto get_elements() {
+		return node_range{ this->begin(), this->end() };
+	}
+
+	auto get_elements() const {
+		return const_cast<adaptive_accessor *>(this)->get_elements();
+	}
+
+	auto &raw_storage() const {
+		return this->storage_;
+	}
+
+	// Exchanges the whole set of children with another node.
+	void swap_children(adaptive_accessor &other) {
+		this->storage_.swap(other.storage_);
+	}
+
+private:
+	static unsigned char key_(value_type val) {
+		return static_cast<unsigned char>(val);
+	}
+
+	node_iterator insert_(value_type val, std::unique_ptr<node_type> child) {
+		int pos = this->storage_.insert(key_(val), child.get());
+		child.release();
+		return { &this->storage_, pos };
+	}
+};
+
+// Children kept as two parallel arrays: the keys on their own, so that a
+// search only touches key bytes, and the owning node pointers next to them.
+template <class RecursiveNode, class ValueT>
+struct split_children
+{
+	// Byte keys are padded to whole SIMD blocks; the padding is never matched.
+	static constexpr size_t key_block = sizeof(ValueT) == 1 ? simd_key_block : 1;
+
+	size_t size() const {
+		return nodes.size();
+	}
+
+	bool empty() const {
+		return nodes.empty();
+	}
+
+	void swap(split_children &other) noexcept {
+		keys.swap(other.keys);
+		nodes.swap(other.nodes);
+	}
+
+	size_t insert(size_t pos, ValueT val, std::unique_ptr<RecursiveNode> child) {
+		size_t count = nodes.size();
+		if (keys.size() == count) keys.resize(count + key_block);
+		nodes.insert(nodes.begin() + pos, std::move(child));
+		std::copy_backward(keys.begin() + pos, keys.begin() + count, keys.begin() + count + 1);
+		keys[pos] = val;
+		return pos;
+	}
+
+	void erase(size_t pos) {
+		size_t count = nodes.size();
+		nodes.erase(nodes.begin() + pos);
+		std::copy(keys.begin() + pos + 1, keys.begin() + count, keys.begin() + pos);
+		// Keep the keys padded to whole blocks, and no more.
+		if (keys.size() - (count - 1) >= key_block) keys.resize(keys.size() - key_block);
+	}
+
+	void shrink_to_fit() {
+		keys.shrink_to_fit();
+		nodes.shrink_to_fit();
+	}
+
+	std::vector<ValueT> keys;
+	std::vector<std::unique_ptr<RecursiveNode>> nodes;
+};
+
+template <class RecursiveNode, class ValueT, class ValueTraits>
+class split_vector_storage
+{
+public:
+	using node_type = RecursiveNode;
+	using entry_type = std::unique_ptr<RecursiveNode>;
+	using storage_t = split_children<RecursiveNode, ValueT>;
+	using value_type = ValueT;
+	using pointer = value_type *;
+	using traits = ValueTraits;
+
+	struct node_iterator
+	{
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = node_type;
+		using reference = value_type &;
+		using pointer = value_type *;
+		using storage_it = typename std::vector<entry_type>::iterator;
+
+		node_iterator(storage_it it) : it_(it) {}
+
+		reference operator*() const {
+			return **it_;
+		}
+
+		node_iterator &operator++ () {
+			++it_;
+			return *this;
+		}
+
+		bool operator==(const node_iterator &rhs) const {
+			return it_ == rhs.it_;
+		}
+
+		bool operator!=(const node_iterator &rhs) const {
+			return it_ != rhs.it_;
+		}
+	private:
+		storage_it it_;
+	};
+
+	node_iterator begin() { return { storage_.nodes.begin() }; }
+	node_iterator end() { return { storage_.nodes.end() }; }
+protected:
+	storage_t storage_;
+};
+
+// Sorted lookup over split_vector_storage. For char tries ordered by
+// std::char_traits the keys are searched with SSE2/AVX2 compares; any other
+// value type or ordering falls back to std::lower_bound.
+template <class StorageT>
+class simd_vector_accessor : private StorageT
+{
+public:
+	using StorageT::StorageT;
+	using StorageT::begin;
+	using StorageT::end;
+	using storage_t = typename StorageT::storage_t;
+	using value_type = typename StorageT::value_type;
+	using traits = typename StorageT::traits;
+	using node_type = typename StorageT::node_type;
+	using node_pointer = node_type *;
+	using pointer = typename StorageT::pointer;
+	using entry_type = typename StorageT::entry_type;
+	using node_iterator = typename StorageT::node_iterator;
+
+	static constexpr bool vectorized = sizeof(value_type) == 1 && simd_key_block > 1 &&
+		std::is_same_v<traits, std::char_traits<value_type>>;
+
+	size_t find_pos(value_type val) const {
+		const auto &keys = this->storage_.keys;
+		size_t count = this->storage_.size();
+		if constexpr (vectorized) {
+			return byte_lower_bound<storage_t::key_block>(
+				reinterpret_cast<const unsigned char *>(keys.data()), count, static_cast<unsigned char>(val));
+		}
+		else {
+			return std::lower_bound(keys.begin(), keys.begin() + count, val, [](value_type lhs, value_type rhs) {
+				return traits::lt(lhs, rhs);
+			}) - keys.begin();
+		}
+	}
+
+	template <class... Ts>
+	node_iterator emplace(value_type val, Ts && ...args) {
+		return insert_(this->find_pos(val), val, std::make_unique<node_type>(val, std::forward<Ts>(args)...));
+	}
+
+	node_iterator get(value_type val) {
+		size_t pos = this->find_pos(val);
+		if (!found_(pos, val)) return this->end();
+		return { this->storage_.nodes.begin() + pos };
+	}
+
+	void reserve(size_t count) {
+		this->storage_.keys.reserve((count + storage_t::key_block - 1) / storage_t::key_block * storage_t::key_block);
+		this->storage_.nodes.reserve(count);
+	}
+
+	// Removes the child holding val, if any, with its subtrie.
+	void remove(value_type val) {
+		size_t pos = this->find_pos(val);
+		if (!found_(pos, val)) return;
+		this->storage_.erase(pos);
+		if (this->storage_.size() <= this->storage_.nodes.capacity() / 4) shrink_to_fit();
+	}
+
+	void shrink_to_fit() {
+		this->storage_.shrink_to_fit();
+	}
+
+	// Adds a child that orders after all the existing ones, without searching.
+	template <class... Ts>
+	node_iterator append(value_type val, Ts && ...args) {
+		return insert_(this->storage_.size(), val, std::make_unique<node_type>(val, std::forward<Ts>(args)...));
+	}
+
+	template <class... Ts>
+	// Parameter pack contains all the arguments needed for the node constructor
+	node_iterator get_or_emplace(value_type val, Ts && ...args) {
+		size_t pos = this->find_pos(val);
+		if (!found_(pos, val))
+			return insert_(pos, val, std::make_unique<node_type>(std::forward<Ts>(args)...));
+
+		return { this->storage_.nodes.begin() + pos };
+	}
+
+	struct node_range
+	{
+		node_range(node_iterator beg, node_iterator end) : beg_(beg), end_(end) {}
+
+		node_iterator begin() { return beg_; }
+		node_iterator end() { return end_; }
+
+		node_iterator beg_;
+		node_iterator end_;
+	};
+
+	auto get_elements() {
+		return node_range{ this->begin(), this->end() };
+	}
+
+	auto get_elements() const {
+		return const_cast<simd_vector_accessor *>(this)->get_elements();
+	}
+
+	auto &raw_storage() const {
+		return this->storage_;
+	}
+
+	// Exchanges the whole set of children with another node.
+	void swap_children(simd_vector_accessor &other) {
+		this->storage_.swap(other.storage_);
+	}
+
+private:
+	bool found_(size_t pos, value_type val) const {
+		return pos < this->storage_.size() && traits::eq(this->storage_.keys[pos], val);
+	}
+
+	node_iterator insert_(size_t pos, value_type val, std::unique_ptr<node_type> child) {
+		this->storage_.insert(pos, val, std::move(child));
+		return { this->storage_.nodes.begin() + pos };
+	}
+};
+
+// Index of every byte in a restricted alphabet, or 0xFF for bytes outside
+// it. The symbols must be distinct and in increasing byte order.
+template <size_t N>
+constexpr std::array<unsigned char, 256> alphabet_index_table(const char (&symbols)[N]) {
+	std::array<unsigned char, 256> table{};
+	for (auto &entry : table) {
+		entry = 0xFF;
+	}
+	for (size_t j = 0; j + 1 < N; ++j) {
+		if (j > 0 && static_cast<unsigned char>(symbols[j - 1]) >= static_cast<unsigned char>(symbols[j])) {
+			throw std::invalid_argument("alphabet symbols must be distinct and in increasing byte order");
+		}
+		table[static_cast<unsigned char>(symbols[j])] = static_cast<unsigned char>(j);
+	}
+	return table;
+}
+
+// Traits of a restricted key alphabet: std::char_traits<char> plus a table,
+// built at compile time, mapping each symbol to a dense index. Alphabet names
+// its symbols in a string literal, in increasing byte order so that index
+// order is the usual string order:
+//
+//     struct dna_alphabet { static constexpr char symbols[] = "ACGT"; };
+//     using dna_trie = trie<char, 255, impl_::alphabet_traits<dna_alphabet>,
+//         impl_::bitmap_storage, impl_::bitmap_accessor>;
+//
+// Keys are then basic_string_views with these traits.
+template <class Alphabet>
+struct alphabet_traits : std::char_traits<char>
+{
+	static constexpr size_t alphabet_size = std::size(Alphabet::symbols) - 1;
+	static constexpr unsigned npos = 0xFF;
+
+	static_assert(alphabet_size < npos, "alphabet_traits: too many symbols");
+
+	static constexpr unsigned index(char c) {
+		return index_table_[static_cast<unsigned char>(c)];
+	}
+
+	static constexpr char symbol(unsigned index) {
+		return Alphabet::symbols[index];
+	}
+
+private:
+	static constexpr std::array<unsigned char, 256> index_table_ = alphabet_index_table(Alphabet::symbols);
+};
+
+struct dna_alphabet
+{
+	static constexpr char symbols[] = "ACGT";
+};
+
+// Lowercase host names, identifiers and file names.
+struct hostname_alphabet
+{
+	static constexpr char symbols[] = "-.0123456789_abcdefghijklmnopqrstuvwxyz";
+};
+
+// Children of a node over an alphabet of at most 64 symbols: a bitmap of the
+// symbol indices present and an array of the children in index order, so
+// that the position of a child is the number of bits set below its index.
+// Lookup is a bit test and a popcount whatever the fan-out. The array
+// capacity is the count rounded up to a power of two and is not stored, which
+// keeps the container at two words.
+template <class RecursiveNode>
+class bitmap_children
+{
+public:
+	static constexpr int npos = -1;
+
+	bitmap_children() = default;
+	bitmap_children(const bitmap_children &) = delete;
+	bitmap_children &operator=(const bitmap_children &) = delete;
+
+	~bitmap_children() {
+		for (size_t j = 0, count = size(); j < count; ++j) {
+			delete children_[j];
+		}
+		delete[] children_;
+	}
+
+	size_t size() const {
+		return popcount64(bits_);
+	}
+
+	bool empty() const {
+		return bits_ == 0;
+	}
+
+	size_t capacity() const {
+		return capacity_for_(size());
+	}
+
+	void swap(bitmap_children &other) noexcept {
+		std::swap(bits_, other.bits_);
+		std::swap(children_, other.children_);
+	}
+
+	int find(unsigned index) const {
+		if (index >= 64 || !((bits_ >> index) & 1)) return npos;
+		return rank_(index);
+	}
+
+	RecursiveNode *at(int pos) const {
+		return children_[pos];
+	}
+
+	RecursiveNode *const *data() const {
+		return children_;
+	}
+
+	// The index must not be present yet. Returns the position of the child.
+	int insert(unsigned index, RecursiveNode *child) {
+		size_t count = size();
+		int pos = rank_(index);
+		if (count == capacity_for_(count)) {
+			RecursiveNode **grown = new RecursiveNode *[capacity_for_(count + 1)];
+			std::copy(children_, children_ + pos, grown);
+			std::copy(children_ + pos, children_ + count, grown + pos + 1);
+			delete[] children_;
+			children_ = grown;
+		}
+		else {
+			std::copy_backward(children_ + pos, children_ + count, children_ + count + 1);
+		}
+		children_[pos] = child;
+		bits_ |= std::uint64_t{ 1 } << index;
+		return pos;
+	}
+
+	// Deletes the child stored under index, which must be present.
+	void erase(unsigned index) {
+		size_t count = size();
+		int pos = rank_(index);
+		delete children_[pos];
+		bits_ &= ~(std::uint64_t{ 1 } << index);
+		// Halve the array when the count drops to a power of two, so that its
+		// size stays the one capacity() infers.
+		if (count - 1 == capacity_for_(count - 1)) {
+			RecursiveNode **shrunk = count > 1 ? new RecursiveNode *[count - 1] : nullptr;
+			std::copy(children_, children_ + pos, shrunk);
+			std::copy(children_ + pos + 1, children_ + count, shrunk + pos);
+			delete[] children_;
+			children_ = shrunk;
+		}
+		else {
+			std::copy(children_ + pos + 1, children_ + count, children_ + pos);
+		}
+	}
+
+private:
+	int rank_(unsigned index) const {
+		return static_cast<int>(popcount64(bits_ & ((std::uint64_t{ 1 } << index) - 1)));
+	}
+
+	static size_t capacity_for_(size_t count) {
+		size_t capacity = 0;
+		while (capacity < count) capacity = capacity ? capacity * 2 : 1;
+		return capacity;
+	}
+
+	std::uint64_t bits_ = 0;
+	RecursiveNode **children_ = nullptr;
+};
+
+// Bitmap children over the alphabet of ValueTraits, an alphabet_traits of at
+// most 64 symbols. Children are ordered by symbol index.
+template <class RecursiveNode, class ValueT, class ValueTraits>
+class bitmap_storage
+{
+	static_assert(ValueTraits::alphabet_size <= 64, "bitmap_storage needs an alphabet of at most 64 symbols");
+public:
+	using node_type = RecursiveNode;
+	using entry_type = RecursiveNode *;
+	using storage_t = bitmap_children<RecursiveNode>;
+	using value_type = ValueT;
+	using pointer = value_type *;
+	using traits = ValueTraits;
+
+	struct node_iterator
+	{
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = node_type;
+		using reference = value_type &;
+		using pointer = value_type *;
+
+		node_iterator(RecursiveNode *const *it) : it_(it) {}
+
+		reference operator*() const {
+			return **it_;
+		}
+
+		node_iterator &operator++ () {
+			++it_;
+			return *this;
+		}
+
+		bool operator==(const node_iterator &rhs) const {
+			return it_ == rhs.it_;
+		}
+
+		bool operator!=(const node_iterator &rhs) const {
+			return it_ != rhs.it_;
+		}
+	private:
+		RecursiveNode *const *it_;
+	};
+
+	node_iterator begin() { return { storage_.data() }; }
+	node_iterator end() { return { storage_.data() + storage_.size() }; }
+protected:
+	storage_t storage_;
+};
+
+template <class StorageT>
+class bitmap_accessor : private StorageT
+{
+public:
+	using StorageT::StorageT;
+	using StorageT::begin;
+	using StorageT::end;
+	using storage_t = typename StorageT::storage_t;
+	using value_type = typename StorageT::value_type;
+	using traits = typename StorageT::traits;
+	using node_type = typename StorageT::node_type;
+	using node_pointer = node_type *;
+	using pointer = typename StorageT::pointer;
+	using entry_type = typename StorageT::entry_type;
+	using node_iterator = typename StorageT::node_iterator;
+
+	template <class... Ts>
+	node_iterator emplace(value_type val, Ts && ...args) {
+		return insert_(val, std::make_unique<node_type>(val, std::forward<Ts>(args)...));
+	}
+
+	// Symbols outside the alphabet are never found.
+	node_iterator get(value_type val) {
+		int pos = this->storage_.find(traits::index(val));
+		if (pos == storage_t::npos) return this->end();
+		return { this->storage_.data() + pos };
+	}
+
+	// The array grows on demand; there is nothing to reserve.
+	void reserve(size_t) {}
+
+	// Removes the child holding val, if any, with its subtrie.
+	void remove(value_type val) {
+		if (this->storage_.find(traits::index(val)) != storage_t::npos) this->storage_.erase(traits::index(val));
+	}
+
+	void shrink_to_fit() {}
+
+	template <class... Ts>
+	node_iterator append(value_type val, Ts && ...args) {
+		return emplace(val, std::forward<Ts>(args)...);
+	}
+
+	template <class... Ts>
+	// Parameter pack contains all the arguments needed for the node constructor
+	node_iterator get_or_emplace(value_type val, Ts && ...args) {
+		int pos = this->storage_.find(traits::index(val));
+		if (pos == storage_t::npos)
+			return insert_(val, std::make_unique<node_type>(std::forward<Ts>(args)...));
+
+		return { this->storage_.data() + pos };
+	}
+
+	struct node_range
+	{
+		node_range(node_iterator beg, node_iterator end) : beg_(beg), end_(end) {}
+
+		node_iterator begin() { return beg_; }
+		node_iterator end() { return end_; }
+
+		node_iterator beg_;
+		node_iterator end_;
+	};
+
+	auto get_elements() {
+		return node_range{ this->begin(), this->end() };
+	}
+
+	auto get_elements() const {
+		return const_cast<bitmap_accessor *>(this)->get_elements();
+	}
+
+	auto &raw_storage() const {
+		return this->storage_;
+	}
+
+	// Exchanges the whole set of children with another node.
+	void swap_children(bitmap_accessor &other) {
+		this->storage_.swap(other.storage_);
+	}
+
+private:
+	// A key with a symbol outside the alphabet cannot be stored.
+	node_iterator insert_(value_type val, std::unique_ptr<node_type> child) {
+		unsigned index = traits::index(val);
+		if (index >= traits::alphabet_size) throw std::invalid_argument("bitmap_accessor: symbol outside the alphabet");
+		int pos = this->storage_.insert(index, child.get());
+		child.release();
+		return { this->storage_.data() + pos };
+	}
+};
+
+// Upward bookkeeping of a node_t: the parent, the depth and the height of the
+// subtrie. With them a node can spell out its own key and leaf() needs no
+// look at the children, for the price of a pointer and two depths per node.
+template <class Node, class DepthT>
+class parent_links
+{
+public:
+	static constexpr bool enabled = true;
+
+	parent_links(Node *parent, DepthT depth) : parent_(parent), depth_(depth), height_(0) {}
+
+	const Node *parent() const {
+		return parent_;
+	}
+
+	Node *parent() {
+		return parent_;
+	}
+
+	DepthT depth() const {
+		return depth_;
+	}
+
+protected:
+	Node *parent_;
+	DepthT depth_;
+	DepthT height_;
+};
+
+// No upward bookkeeping at all, for large read-mostly tries: a node is down to
+// its value, its mark and its children. Keys are recovered with traversal
+// stacks (see utils::node_to_string) and heights are computed when asked for.
+template <class Node, class DepthT>
+class no_links
+{
+public:
+	static constexpr bool enabled = false;
+
+	no_links(Node *, DepthT) {}
+};
+
+template <
+	class ValueT, 
+	class DepthT, 
+	class ValueTraits, 
+	template <class, class, class> class Storage = impl_::default_vector_storage, 
+	template<class> class Accessor = impl_::default_vector_accessor,
+	template <class, class> class Links = impl_::parent_links>
+class node_t : public 
+	Accessor<Storage<node_t<ValueT, DepthT, ValueTraits, Storage, Accessor, Links>, ValueT, ValueTraits>>,
+	public Links<node_t<ValueT, DepthT, ValueTraits, Storage, Accessor, Links>, DepthT>
+{
+	using StorageT_ = Storage<node_t, ValueT, ValueTraits>;
+	using AccessorT_ = Accessor<Storage<node_t, ValueT, ValueTraits>>;
+	using LinksT_ = Links<node_t, DepthT>;
+
+public:
+	using value_type = ValueT;
+	using depth_type = DepthT;
+	using traits_type = ValueTraits;
+	using links_type = LinksT_;
+	//using iterator = typename AccessorT_::child_iterator;
+	//using allocator_type = Allocator;
+
+	node_t(ValueT ch, node_t *parent, DepthT depth, bool marked = false) :
+		LinksT_(parent, depth), value_(ch), marked_(marked)
+	{}
+
+	// Used by storages that allocate from an arena: the allocator is handed
+	// down to the node's own child storage.
+	template <class Alloc>
+	node_t(std::allocator_arg_t, const Alloc &alloc, ValueT ch, node_t *parent, DepthT depth, bool marked = false) :
+		AccessorT_(alloc), LinksT_(parent, depth), value_(ch), marked_(marked)
+	{}
+
+	node_t *emplace_child(ValueT c, bool marked = false) {
+		if constexpr (LinksT_::enabled) {
+			if (this->height_ == 0) increase_height();
+		}
+		return this->AccessorT_::emplace(c, this, child_depth_(), marked);
+	}
+
+	node_t *get_or_emplace(ValueT c) {
+		if constexpr (LinksT_::enabled) {
+			if (this->height_ == 0) increase_height();
+		}
+		return mut_ptr_cast_(std::addressof(*this->AccessorT_::get_or_emplace(c, c, this, child_depth_(), false)));
+	}
+
+	void reserve_children(size_t count) {
+		this->AccessorT_::reserve(count);
+	}
+
+	// Bulk building: c must order after every existing child, and heights are
+	// left alone until refresh_height is called on the way back up.
+	node_t *append_child(ValueT c) {
+		return mut_ptr_cast_(std::addressof(*this->AccessorT_::append(c, this, child_depth_(), false)));
+	}
+
+	// Hint that the children are about to be searched.
+	void prefetch_children() const {
+		const auto &children = this->raw_storage();
+		if constexpr (has_data<std::decay_t<decltype(children)>>::value) {
+			if (!children.empty()) prefetch(children.data());
+		}
+	}
+
+	// Points the children's parent links back at this node, after the node
+	// itself was moved to a new address.
+	void adopt_children() {
+		if constexpr (LinksT_::enabled) {
+			for (node_t &child : this->get_elements()) {
+				child.parent_ = this;
+			}
+		}
+	}
+
+	// Recomputes the height from the children's heights. Nothing to do
+	// without links, where heights are not stored.
+	void refresh_height() {
+		if constexpr (LinksT_::enabled) {
+			this->height_ = 0;
+			for (const node_t &child : this->get_elements()) {
+				this->height_ = std::max<DepthT>(this->height_, child.height_ + 1);
+			}
+		}
+	}
+
+	// Length of the longest key suffix below this node. Without links this
+	// walks the whole subtrie.
+	size_t height() const {
+		if constexpr (LinksT_::enabled) {
+			return this->height_;
+		}
+		else {
+			size_t result = 0;
+			for (const node_t &child : this->get_elements()) {
+				result = std::max(result, child.height() + 1);
+			}
+			return result;
+		}
+	}
+
+	using path_list = std::vector<const node_t *>;
+
+	path_list paths_to(ValueT v, unsigned min_height_req = 0) const {
+		path_list results;
+		for (auto &node : this->get_elements()) {
+
+			if (const node_t *n = node.get_child(v)) {
+				if (n->height() >= min_height_req) {
+					results.push_back(n);
+				}
+			}
+		}
+
+		return results;
+	}
+
+	void append_paths_to(path_list &results, ValueT v, unsigned min_height_req = 0) const {
+		for (const node_t &node : this->AccessorT::get_elements()) {
+			if (const node_t *n = node.get_child(v)) {
+				if (n->height() >= min_height_req) {
+					results.push_back(n);
+				}
+			}
+		}
+	}
+
+
+	path_list paths_to2(ValueT v, unsigned min_height_req = 0) const {
+		path_list results;
+		for (const node_t &node : this->AccessorT::get_elements()) {
+			node.append_paths_to(results, v, min_height_req);
+
+		}
+
+		return results;
+	}
+
+
+
+
+	// Deletes the child holding v, and its subtrie.
+	void remove_child(ValueT v) {
+		this->AccessorT_::remove(v);
+		decrease_height();
+	}
+
+	// Deletes every unmarked subtrie that holds no key and releases spare
+	// child capacity, all the way down. Returns true if nothing is left
+	// below or at this node.
+	bool compact() {
+		std::vector<ValueT> dead;
+		for (node_t &child : this->get_elements()) {
+			if (child.compact()) dead.push_back(child.value());
+		}
+		for (ValueT v : dead) {
+			this->AccessorT_::remove(v);
+		}
+		this->AccessorT_::shrink_to_fit();
+		refresh_height();
+		return !marked_ && this->raw_storage().empty();
+	}
+
+	void mark() {
+		marked_ = true;
+	}
+
+	void unmark() {
+		marked_ = false;
+	}
+
+	bool marked() const {
+		return marked_;
+	}
+
+	bool leaf() const {
+		if constexpr (LinksT_::enabled) {
+			return this->height_ == 0;
+		}
+		else {
+			return this->raw_storage().empty();
+		}
+	}
+
+	ValueT value() const {
+		return value_;
+	}
+
+	node_t *get_child(ValueT ch) {
+		auto it = this->AccessorT_::get(ch);
+		if (it == this->end()) return nullptr;
 		return mut_ptr_cast_(std::addressof(*this->AccessorT_::get(ch)));
 	}
 
-	node_t *mut_ptr_cast_(const node_t *node) {
-		return const_cast<node_t *>(node);
+	node_t *mut_ptr_cast_(const node_t *node) {
+		return const_cast<node_t *>(node);
+	}
+
+	const node_t *get_child(ValueT ch) const {
+		return const_cast<node_t *>(this)->get_child(ch);
+	}
+	const auto &get_children() const {
+		return const_cast<node_t *>(this)->AccessorT_::raw_storage();
+	}
+
+private:
+	DepthT child_depth_() const {
+		if constexpr (LinksT_::enabled) {
+			return this->depth_ + 1;
+		}
+		else {
+			return 0;
+		}
+	}
+
+	void increase_height() {
+		++this->height_;
+		if (this->parent_ && this->parent_->height_ <= this->height_) {
+			this->parent_->increase_height();
+		}
+	}
+
+	// After a child went away: recomputes the height, and the parent's for
+	// as long as heights keep dropping.
+	void decrease_height() {
+		if constexpr (LinksT_::enabled) {
+			DepthT old = this->height_;
+			refresh_height();
+			if (this->parent_ && this->height_ < old && this->parent_->height_ == old + 1) {
+				this->parent_->decrease_height();
+			}
+		}
+	}
+
+private:
+	ValueT value_;
+	bool marked_;
+};
+
+
+// Hot-path statistics are only gathered when TRIE_STATS is defined. Without
+// it the counters below are empty and every update compiles to nothing.
+#ifdef TRIE_STATS
+constexpr bool stats_enabled = true;
+
+// Per-walk count, owned by a single thread.
+struct stat_counter
+{
+	void add(size_t n = 1) {
+		value_ += n;
+	}
+
+	size_t get() const {
+		return value_;
 	}
 
-	const node_t *get_child(ValueT ch) const {
-		return const_cast<node_t *>(this)->get_child(ch);
+private:
+	size_t value_ = 0;
+};
+
+// Calls of one trie operation and the nodes they visited. Updated by const
+// member functions, possibly from several readers at once.
+struct op_counter
+{
+	op_counter() = default;
+
+	// The counts go with the trie when it is copied or moved.
+	op_counter(const op_counter &other) :
+		calls_(other.calls()), visited_(other.visited())
+	{}
+
+	op_counter &operator=(const op_counter &other) {
+		calls_.store(other.calls(), std::memory_order_relaxed);
+		visited_.store(other.visited(), std::memory_order_relaxed);
+		return *this;
 	}
-	const auto &get_children() const {
-		return const_cast<node_t *>(this)->AccessorT_::raw_storage();
+
+	void record(size_t visited) const {
+		calls_.fetch_add(1, std::memory_order_relaxed);
+		visited_.fetch_add(visited, std::memory_order_relaxed);
 	}
 
-	const node_t *parent() const {
-		return parent_;
+	size_t calls() const {
+		return calls_.load(std::memory_order_relaxed);
 	}
 
-	node_t *parent() {
-		return parent_;
+	size_t visited() const {
+		return visited_.load(std::memory_order_relaxed);
 	}
 
-	DepthT depth() const {
-		return depth_;
+	void reset() {
+		calls_ = 0;
+		visited_ = 0;
 	}
 
 private:
-	void increase_height() {
-		++height_;
-		if (parent_ && parent_->height_ <= this->height_) {
-			parent_->increase_height();
+	mutable std::atomic<size_t> calls_{ 0 };
+	mutable std::atomic<size_t> visited_{ 0 };
+};
+#else
+constexpr bool stats_enabled = false;
+
+struct stat_counter
+{
+	void add(size_t = 1) {}
+	size_t get() const { return 0; }
+};
+
+struct op_counter
+{
+	void record(size_t) const {}
+	size_t calls() const { return 0; }
+	size_t visited() const { return 0; }
+	void reset() {}
+};
+#endif
+
+// Lazily enumerates the keys below a node, in the same order as
+// trie::complete_suggestions. The walk keeps an explicit stack of child
+// ranges, and each key is assembled in a single buffer that is reused for the
+// next one, so reading a result costs no allocation once the buffer and stack
+// have grown to the depth of the subtrie. Yielded views are valid until the
+// iterator is incremented.
+template <class Node>
+class completion_range
+{
+	using elements_type = decltype(std::declval<const Node &>().get_elements());
+	using child_iterator = decltype(std::declval<elements_type>().begin());
+
+	struct frame
+	{
+		child_iterator next;
+		child_iterator end;
+	};
+
+public:
+	using value_type = typename Node::value_type;
+	using traits_type = typename Node::traits_type;
+	using string_view = std::basic_string_view<value_type, traits_type>;
+
+	class iterator
+	{
+	public:
+		using iterator_category = std::input_iterator_tag;
+		using value_type = string_view;
+		using difference_type = std::ptrdiff_t;
+		using pointer = const string_view *;
+		using reference = string_view;
+
+		iterator() = default;
+
+		string_view operator*() const {
+			return range_->buffer_;
+		}
+
+		// The node that spells out the current key.
+		const Node &node() const {
+			return *range_->current_;
+		}
+
+		iterator &operator++() {
+			if (!range_->advance_()) range_ = nullptr;
+			return *this;
+		}
+
+		bool operator==(const iterator &rhs) const {
+			return range_ == rhs.range_;
+		}
+
+		bool operator!=(const iterator &rhs) const {
+			return range_ != rhs.range_;
 		}
+
+	private:
+		friend class completion_range;
+		explicit iterator(completion_range *range) : range_(range) {}
+
+		completion_range *range_ = nullptr;
+	};
+
+	completion_range() = default;
+
+	// n is the node reached by prefix, or nullptr for an empty range.
+	completion_range(const Node *n, string_view prefix) : root_(n), buffer_(prefix) {}
+
+	// Single pass: begin may only be called once.
+	iterator begin() {
+		if (!root_) return {};
+		push_(*root_);
+		current_ = root_;
+		if (root_->marked() || advance_()) return iterator{ this };
+		return {};
 	}
 
-	void decrease_height() {
-		--height_;
-		if (parent_ && parent_->height_ >= this->height_) {
-			parent_->decrease_height();
+	iterator end() {
+		return {};
+	}
+
+	// Nodes walked through so far; always 0 without TRIE_STATS.
+	size_t nodes_visited() const {
+		return visited_.get();
+	}
+
+private:
+	void push_(const Node &n) {
+		auto &&elements = n.get_elements();
+		stack_.push_back({ elements.begin(), elements.end() });
+	}
+
+	// Moves to the next marked node; false once the subtrie is exhausted.
+	bool advance_() {
+		while (!stack_.empty()) {
+			frame &top = stack_.back();
+			if (top.next == top.end) {
+				stack_.pop_back();
+				if (!stack_.empty()) buffer_.pop_back();
+				continue;
+			}
+
+			const Node &child = *top.next;
+			++top.next;
+			visited_.add();
+			buffer_.push_back(child.value());
+			push_(child);
+			current_ = &child;
+			if (child.marked()) return true;
+		}
+		return false;
+	}
+
+	const Node *root_ = nullptr;
+	const Node *current_ = nullptr;
+	std::basic_string<value_type, traits_type> buffer_;
+	std::vector<frame> stack_;
+	stat_counter visited_;
+};
+
+// Rows of the edit distance table between a query and a candidate that is
+// built one character at a time, as during a depth-first walk of a trie.
+// Each push costs one row, and the smallest value in that row bounds the
+// distance of every candidate extending the current one, which is what lets
+// the walk prune whole subtries. Only the diagonal band of cells that can
+// stay within max_changes is computed; everything outside it reads as
+// max_changes + 1. With transpositions, swapping two adjacent characters
+// counts as a single edit (optimal string alignment distance).
+template <class CharT, class Traits>
+class edit_distance_rows
+{
+public:
+	using string = std::basic_string<CharT, Traits>;
+	using string_view = std::basic_string_view<CharT, Traits>;
+
+	edit_distance_rows(string_view query, unsigned max_changes, bool transpositions) :
+		query_(query), width_(query.size() + 1), limit_(max_changes + 1), transpositions_(transpositions)
+	{
+		rows_.resize(width_ * (query.size() + max_changes + 2));
+		for (size_t j = 0; j < width_; ++j) {
+			rows_[j] = static_cast<unsigned>(std::min<size_t>(j, limit_));
+		}
+	}
+
+	// Appends c to the candidate. Returns the smallest value of the new row.
+	unsigned push(CharT c) {
+		size_t depth = candidate_.size();
+		if (rows_.size() < (depth + 2) * width_) rows_.resize((depth + 2) * width_);
+		unsigned *row = rows_.data() + (depth + 1) * width_;
+		const unsigned *prev = row - width_;
+
+		row[0] = static_cast<unsigned>(std::min<size_t>(depth + 1, limit_));
+		unsigned row_min = row[0];
+		size_t lo = depth + 1 > limit_ ? depth + 2 - limit_ : 1;
+		size_t hi = std::min(width_ - 1, depth + limit_);
+		if (lo > 1) row[lo - 1] = limit_;
+		for (size_t j = lo; j <= hi; ++j) {
+			unsigned cost = Traits::eq(query_[j - 1], c) ? 0 : 1;
+			row[j] = std::min({ prev[j] + 1, row[j - 1] + 1, prev[j - 1] + cost });
+			if (transpositions_ && depth > 0 && j > 1 &&
+				Traits::eq(query_[j - 1], candidate_.back()) && Traits::eq(query_[j - 2], c)) {
+				row[j] = std::min(row[j], (prev - width_)[j - 2] + 1);
+			}
+			row_min = std::min(row_min, row[j]);
 		}
+		if (hi + 1 < width_) row[hi + 1] = limit_;
+		candidate_.push_back(c);
+		pushes_.add();
+		return row_min;
+	}
+
+	void pop() {
+		candidate_.pop_back();
+	}
+
+	// Distance between the query and the current candidate, or
+	// max_changes + 1 if it is larger than max_changes.
+	unsigned distance() const {
+		size_t depth = candidate_.size();
+		size_t gap = depth > width_ - 1 ? depth - (width_ - 1) : width_ - 1 - depth;
+		if (gap >= limit_) return limit_;
+		return std::min(rows_[depth * width_ + width_ - 1], limit_);
+	}
+
+	const string &candidate() const {
+		return candidate_;
+	}
+
+	// Characters pushed so far, that is trie nodes visited by the walk;
+	// always 0 without TRIE_STATS.
+	size_t pushes() const {
+		return pushes_.get();
 	}
 
 private:
-	node_t *parent_;
-	ValueT value_;
+	string_view query_;
+	size_t width_;
+	unsigned limit_;
+	bool transpositions_;
+	std::vector<unsigned> rows_;
+	string candidate_;
+	stat_counter pushes_;
+};
 
-	DepthT depth_; 
-	DepthT height_;
-	unsigned marked_ : 1;
-	unsigned collapsed_ : 1;
+struct no_arena {};
+
+// Heap bytes held by a node's child container, the child nodes included but
+// not their own children. One overload per kind of storage.
+template <class Entry, class Alloc>
+size_t children_bytes(const std::vector<Entry, Alloc> &children, size_t node_size) {
+	return children.capacity() * sizeof(Entry) + children.size() * node_size;
+}
+
+template <class Node, class Compare, class Alloc>
+size_t children_bytes(const std::set<Node, Compare, Alloc> &children, size_t) {
+	// Every child is the payload of a tree node: three links and a colour.
+	return children.size() * (sizeof(Node) + 4 * sizeof(void *));
+}
+
+template <class Node>
+size_t children_bytes(const adaptive_children<Node> &children, size_t node_size) {
+	return children.body_bytes() + children.size() * node_size;
+}
+
+template <class Node>
+size_t children_bytes(const bitmap_children<Node> &children, size_t node_size) {
+	return children.capacity() * sizeof(Node *) + children.size() * node_size;
+}
+
+template <class Node, class ValueT>
+size_t children_bytes(const split_children<Node, ValueT> &children, size_t node_size) {
+	return children.keys.capacity() * sizeof(ValueT)
+		+ children.nodes.capacity() * sizeof(std::unique_ptr<Node>)
+		+ children.size() * node_size;
+}
+
+// Storages that allocate from an arena advertise it through arena_type; the
+// trie then owns one and hands it to the root node.
+template <class StorageT, class = void>
+struct storage_arena {
+	using type = no_arena;
 };
 
+template <class StorageT>
+struct storage_arena<StorageT, std::void_t<typename StorageT::arena_type>> {
+	using type = typename StorageT::arena_type;
+};
 
 template <size_t MaxDepth>
 struct depth_t_selector {
@@ -484,6 +2300,7 @@ struct depth_t_selector {
 }// namespace impl_
 
 namespace utils {
+// Walks up the parent links of n, so only for nodes that have them.
 template <class Node>
 decltype(auto) node_to_string(const Node *n, size_t extra_entries = 0) {
 	std::basic_string<
@@ -502,25 +2319,290 @@ decltype(auto) node_to_string(const Node *n, size_t extra_entries = 0) {
 	return result;
 }
 
+// Works for nodes without parent links too: n is looked for below root by a
+// depth-first walk that keeps the characters of the current path in the
+// result and the child ranges still to visit on a stack. That is linear in
+// the size of the subtrie, so this is meant for diagnostics, not hot paths.
+// Returns an empty string if n is not below root.
+template <class Node>
+decltype(auto) node_to_string(const Node *root, const Node *n, size_t extra_entries = 0) {
+	using elements_type = decltype(std::declval<const Node &>().get_elements());
+	using child_iterator = decltype(std::declval<elements_type>().begin());
+	struct frame
+	{
+		child_iterator next;
+		child_iterator end;
+	};
+
+	std::basic_string<
+		typename Node::value_type,
+		typename Node::traits_type> result;
+	result.reserve(root->height() + extra_entries);
+
+	std::vector<frame> stack;
+	auto push = [&](const Node &m) {
+		auto &&elements = m.get_elements();
+		stack.push_back({ elements.begin(), elements.end() });
+	};
+	if (root != n) push(*root);
+	while (!stack.empty()) {
+		frame &top = stack.back();
+		if (top.next == top.end) {
+			stack.pop_back();
+			if (!stack.empty()) result.pop_back();
+			continue;
+		}
+
+		const Node &child = *top.next;
+		++top.next;
+		result.push_back(child.value());
+		if (&child == n) break;
+		push(child);
+	}
+
+	return result;
+}
+
 } // namespace utils
 
 /*****************************************************************************/
 
+// Defined in frozen_trie.hpp.
+template <class CharT, class Traits>
+class frozen_trie;
+
+// Snapshot of the shape of a trie, from trie::stats. The structural part is
+// always filled in; the operation counters stay at zero unless TRIE_STATS is
+// defined.
+struct trie_stats
+{
+	struct op_stats
+	{
+		size_t calls = 0;
+		size_t nodes_visited = 0;
+	};
+
+	size_t keys = 0;
+	size_t nodes = 0;
+	// Heap bytes held by the nodes and their child containers, spare
+	// capacity included. The root lives inside the trie and is not counted.
+	size_t bytes = 0;
+	// Bytes reserved by the node arena, for storages that allocate from one.
+	size_t arena_bytes = 0;
+	// fanout[k] is the number of nodes with k children, depth[d] the number
+	// of nodes d characters below the root.
+	std::vector<size_t> fanout;
+	std::vector<size_t> depth;
+
+	op_stats find_prefix;
+	op_stats complete_suggestions;
+	op_stats closest_matches;
+
+	std::string to_json() const {
+		std::string json = "{";
+		json += "\"keys\":" + std::to_string(keys);
+		json += ",\"nodes\":" + std::to_string(nodes);
+		json += ",\"bytes\":" + std::to_string(bytes);
+		json += ",\"arena_bytes\":" + std::to_string(arena_bytes);
+		json += ",\"fanout\":" + array_json_(fanout);
+		json += ",\"depth\":" + array_json_(depth);
+		json += ",\"find_prefix\":" + op_json_(find_prefix);
+		json += ",\"complete_suggestions\":" + op_json_(complete_suggestions);
+		json += ",\"closest_matches\":" + op_json_(closest_matches);
+		return json + "}";
+	}
+
+private:
+	static std::string array_json_(const std::vector<size_t> &values) {
+		std::string json = "[";
+		for (size_t j = 0; j < values.size(); ++j) {
+			if (j) json += ',';
+			json += std::to_string(values[j]);
+		}
+		return json + "]";
+	}
+
+	static std::string op_json_(const op_stats &op) {
+		return "{\"calls\":" + std::to_string(op.calls) + ",\"nodes_visited\":" + std::to_string(op.nodes_visited) + "}";
+	}
+};
+
 template <
 	class CharT = char, 
 	size_t MaxNodeDepth = 255,
 	class Traits = std::char_traits<CharT>,
 	template <class, class, class> class Storage = impl_::default_vector_storage, 
-	template <class> class Accessor = impl_::default_vector_accessor>
+	template <class> class Accessor = impl_::default_vector_accessor,
+	template <class, class> class Links = impl_::parent_links>
 class trie
 {
 public:
 	using node = impl_::node_t<CharT, 
 		typename impl_::depth_t_selector<MaxNodeDepth>::type,
-		Traits, Storage, Accessor>;
+		Traits, Storage, Accessor, Links>;
 
 	using string = std::basic_string<CharT, Traits>;
 	using string_view = std::basic_string_view<CharT, Traits>;
+	using completion_range = impl_::completion_range<node>;
+
+	trie() = default;
+
+	// The root is held by value, so its children are pointed at the new one.
+	// Tries whose storage allocates from an arena cannot be moved.
+	trie(trie &&other) :
+		root_(std::move(other.root_)), size_(other.size_),
+		find_prefix_stats_(other.find_prefix_stats_), complete_stats_(other.complete_stats_),
+		closest_stats_(other.closest_stats_)
+	{
+		static_assert(std::is_same_v<arena_type, impl_::no_arena>, "trie: arena tries are not movable");
+		root_.adopt_children();
+		other.clear_();
+	}
+
+	trie &operator=(trie &&other) {
+		static_assert(std::is_same_v<arena_type, impl_::no_arena>, "trie: arena tries are not movable");
+		if (this != &other) {
+			root_ = std::move(other.root_);
+			size_ = other.size_;
+			find_prefix_stats_ = other.find_prefix_stats_;
+			complete_stats_ = other.complete_stats_;
+			closest_stats_ = other.closest_stats_;
+			root_.adopt_children();
+			other.clear_();
+		}
+		return *this;
+	}
+
+	// Builds the trie from keys sorted by Traits::compare; see build_sorted.
+	template <class ForwardIt>
+	trie(ForwardIt first, ForwardIt last) {
+		build_sorted(first, last);
+	}
+
+	// Adds a range of keys sorted by Traits::compare (duplicates allowed).
+	// On an empty trie this is done in one pass: children are appended in
+	// order with exactly the capacity they need, and heights are computed
+	// once on the way back up. Otherwise it falls back to add.
+	template <class ForwardIt>
+	void build_sorted(ForwardIt first, ForwardIt last) {
+		if (!root_.leaf()) {
+			for (; first != last; ++first) add(*first);
+			return;
+		}
+		size_ += build_sorted_impl(root_, first, last, 0);
+	}
+
+	// Same as build_sorted, with the subtries built concurrently. The keys
+	// are split by leading characters, one character deeper for any prefix
+	// that still holds too many keys, and the parts are handed out to a pool
+	// of threads. Storages that allocate from the trie's arena, and tries that
+	// are not empty, are built on the calling thread.
+	template <class ForwardIt>
+	void build_sorted_parallel(ForwardIt first, ForwardIt last, unsigned threads = std::thread::hardware_concurrency()) {
+		if (threads <= 1 || !root_.leaf() || !std::is_same_v<arena_type, impl_::no_arena>) {
+			build_sorted(first, last);
+			return;
+		}
+
+		struct task
+		{
+			node *n;
+			ForwardIt first;
+			ForwardIt last;
+			size_t depth;
+			size_t count;
+		};
+
+		size_t total = std::distance(first, last);
+		size_t grain = std::max<size_t>(1, total / (threads * 8));
+
+		std::vector<task> tasks;
+		std::vector<task> pending{ { &root_, first, last, 0, total } };
+		std::vector<node *> expanded;
+		while (!pending.empty()) {
+			task t = pending.back();
+			pending.pop_back();
+			if (t.count <= grain) {
+				tasks.push_back(t);
+				continue;
+			}
+
+			// Too big: split it one character further, on this thread.
+			expanded.push_back(t.n);
+			for (; t.first != t.last && string_view{ *t.first }.length() == t.depth; ++t.first) {
+				if (!t.n->marked()) {
+					++size_;
+					t.n->mark();
+				}
+			}
+			size_t groups = 0;
+			for (ForwardIt it = t.first; it != t.last; ++groups) {
+				it = next_group_(it, t.last, t.depth);
+			}
+			t.n->reserve_children(groups);
+			while (t.first != t.last) {
+				ForwardIt group_last = next_group_(t.first, t.last, t.depth);
+				node *child = t.n->append_child(string_view{ *t.first }[t.depth]);
+				pending.push_back({ child, t.first, group_last, t.depth + 1, static_cast<size_t>(std::distance(t.first, group_last)) });
+				t.first = group_last;
+			}
+		}
+
+		// Largest parts first, so that no thread is left with a big one at the end.
+		std::sort(tasks.begin(), tasks.end(), [](const task &lhs, const task &rhs) {
+			return lhs.count > rhs.count;
+		});
+
+		std::atomic<size_t> next{ 0 };
+		std::atomic<size_t> added{ 0 };
+		std::exception_ptr error;
+		std::mutex error_mutex;
+		auto worker = [&] {
+			size_t local = 0;
+			try {
+				for (size_t j; (j = next++) < tasks.size();) {
+					local += build_sorted_impl(*tasks[j].n, tasks[j].first, tasks[j].last, tasks[j].depth);
+				}
+			}
+			catch (...) {
+				std::lock_guard<std::mutex> lock{ error_mutex };
+				if (!error) error = std::current_exception();
+				next = tasks.size();
+			}
+			added += local;
+		};
+
+		// Threads are joined however this block is left. If some cannot be
+		// started, the ones that did and this thread share the tasks; with
+		// none, this thread builds them all, serially.
+		struct joiner
+		{
+			~joiner() {
+				for (auto &thread : pool) {
+					if (thread.joinable()) thread.join();
+				}
+			}
+			std::vector<std::thread> pool;
+		};
+		{
+			joiner workers;
+			workers.pool.reserve(threads - 1);
+			try {
+				for (unsigned j = 1; j < threads; ++j) {
+					workers.pool.emplace_back(worker);
+				}
+			}
+			catch (const std::system_error &) {}
+			worker();
+		}
+		if (error) std::rethrow_exception(error);
+
+		size_ += added;
+		// Children were expanded after their parents.
+		for (auto it = expanded.rbegin(); it != expanded.rend(); ++it) {
+			(*it)->refresh_height();
+		}
+	}
 
 	void add(string_view s) {
 		node *current = &root_;
@@ -537,10 +2619,14 @@ public:
 		node *current = &root_;
 		for (size_t j = 0, len = s.length(); j < len; ++j) {
 			node *it = current->get_child(s[j]);
-			if (!it) return closest_match ? current : nullptr;
+			if (!it) {
+				find_prefix_stats_.record(j);
+				return closest_match ? current : nullptr;
+			}
 			current = it;
 		}
 
+		find_prefix_stats_.record(s.length());
 		return current;
 	}
 
@@ -548,6 +2634,99 @@ public:
 		return const_cast<trie *>(this)->find_prefix(s, closest_match);
 	}
 
+	// The longest key that is a prefix of s, and its length, in a single pass
+	// that remembers the last marked node on the way down. The root does not
+	// count, so no match is { nullptr, 0 }.
+	std::pair<node *, size_t> longest_prefix_match(string_view s) {
+		std::pair<node *, size_t> match{ nullptr, 0 };
+		node *current = &root_;
+		for (size_t j = 0, len = s.length(); j < len; ++j) {
+			current = current->get_child(s[j]);
+			if (!current) break;
+			if (current->marked()) match = { current, j + 1 };
+		}
+		return match;
+	}
+
+	std::pair<const node *, size_t> longest_prefix_match(string_view s) const {
+		return const_cast<trie *>(this)->longest_prefix_match(s);
+	}
+
+	// Greedy tokenization: splits text into the longest keys that match at
+	// each position, calling f(token, true) for each of them, in order.
+	// Characters where no key starts are grouped into runs that are passed
+	// as f(run, false). Tokens are views into text; nothing is allocated.
+	template <class F>
+	void tokenize(string_view text, F &&f) const {
+		size_t unmatched = 0;
+		for (size_t pos = 0; pos < text.length();) {
+			size_t len = longest_prefix_match(text.substr(pos)).second;
+			if (len == 0) {
+				++pos;
+				continue;
+			}
+			if (unmatched < pos) f(text.substr(unmatched, pos - unmatched), false);
+			f(text.substr(pos, len), true);
+			pos += len;
+			unmatched = pos;
+		}
+		if (unmatched < text.length()) f(text.substr(unmatched), false);
+	}
+
+	// Batched find_prefix: out[j] = find_prefix(keys[j]) for every key in
+	// [first, last), counted as find_prefix calls by stats(). Keys are walked in lockstep, one level at a time, and
+	// every node is prefetched a step before it is searched, so the cache
+	// misses of different keys overlap instead of queueing up.
+	template <class RandomIt, class OutIt>
+	void find_many(RandomIt first, RandomIt last, OutIt out) const {
+		constexpr size_t batch = 16;
+		string_view keys[batch];
+		const node *current[batch];
+		size_t active[batch];
+
+		while (first != last) {
+			size_t count = std::min<size_t>(batch, last - first);
+			for (size_t j = 0; j < count; ++j) {
+				keys[j] = first[j];
+				current[j] = &root_;
+				active[j] = j;
+			}
+
+			size_t remaining = count;
+			for (size_t depth = 0; remaining; ++depth) {
+				size_t kept = 0;
+				for (size_t a = 0; a < remaining; ++a) {
+					size_t j = active[a];
+					if (keys[j].length() == depth) {
+						out[j] = current[j];
+						find_prefix_stats_.record(depth);
+						continue;
+					}
+					current[j]->prefetch_children();
+					active[kept++] = j;
+				}
+				remaining = kept;
+
+				kept = 0;
+				for (size_t a = 0; a < remaining; ++a) {
+					size_t j = active[a];
+					const node *child = current[j]->get_child(keys[j][depth]);
+					if (!child) {
+						out[j] = nullptr;
+						find_prefix_stats_.record(depth);
+						continue;
+					}
+					impl_::prefetch(child);
+					current[j] = child;
+					active[kept++] = j;
+				}
+				remaining = kept;
+			}
+			first += count;
+			out += count;
+		}
+	}
+
 	node *find_suffix(const node *n, string_view s, bool allow_unmarked = false) {
 		if (s.empty()) return n;
 
@@ -569,63 +2748,38 @@ public:
 
 	}
 
-	std::vector<string> complete_suggestions(string_view s) {
-		const node *it = find_prefix(s);
-		if (!it) return{};
-
-		auto sug = suggestions_impl(*it, s);
-		if (it->marked()) {
-			sug.emplace_back(s);
-			std::iter_swap(begin(sug), end(sug) - 1);
+	// Every key starting with s: s itself first if present, then the others
+	// depth first.
+	std::vector<string> complete_suggestions(string_view s) const {
+		std::vector<string> results;
+		completion_range range = completions(s);
+		for (string_view key : range) {
+			results.emplace_back(key);
 		}
-		return sug;
+		complete_stats_.record(range.nodes_visited());
+		return results;
 	}
 
-	std::vector<string> closest_matches(string_view s, unsigned changes = 1) {
-		const node *it = find_prefix(s, true);
-		// Ignore any word whose first letter is incorrect.
-		if (!it) return{};
-
-		// Calculate how far away the node is from the actual string length.
-		size_t diff = s.size() - it->depth();
-
-		// Trivial case: the found node matches the string.
-		if (diff == 0) return { string{s} };
-
-		// We give up if the we diverge farther away than the last 2 characters.
-		if (diff > 2) return {};
+	// Lazy version of complete_suggestions; see impl_::completion_range.
+	completion_range completions(string_view s) const {
+		return { find_prefix(s), s };
+	}
 
+	// Every key within the given number of edits of s (insertions, deletions
+	// and substitutions, plus adjacent transpositions if asked for), in the
+	// order of complete_suggestions. This is a single walk of the trie that
+	// keeps one row of the edit distance table per level and skips any
+	// subtrie whose row is already over the limit.
+	std::vector<string> closest_matches(string_view s, unsigned changes = 1, bool transpositions = false) const {
 		std::vector<string> results;
-		if (diff == 1) {
-			for (const node &child : it->get_elements()) {
-				if (child.marked()) 
-					results.push_back(utils::node_to_string(&child));
-			}
-
-			return results;
-		}
-
-		auto paths_to_last = it->paths_to(*(s.end() - 1));
-		results.reserve(paths_to_last.size());
-
-		for (const node *n : paths_to_last) {
-			if (n->marked()) 
-				results.push_back(utils::node_to_string(n));
-		}
-
+		impl_::edit_distance_rows<CharT, Traits> rows{ s, changes, transpositions };
+		closest_impl(root_, rows, changes, results);
+		closest_stats_.record(rows.pushes());
 		return results;
 	}
 
-	std::vector<string> closest_suggestions(string_view s) {
-		const node *it = find_prefix(s);
-		if (!it) return{};
-
-		auto sug = suggestions_impl(*it, s);
-		if (it->marked()) {
-			sug.push_back(s);
-			std::iter_swap(begin(sug), end(sug) - 1);
-		}
-		return sug;
+	std::vector<string> closest_suggestions(string_view s) const {
+		return complete_suggestions(s);
 	}
 
 
@@ -644,51 +2798,131 @@ public:
 	}
 #endif
 	
+	// Removes s. Nodes left without a key below them are deleted, and
+	// heights are brought back up to date along the way.
 	void remove(string_view s) {
-		node *it = find_prefix(s);
-
-		if (!it) {
-			return;
-		}
-		--size_;
-		if (!it->leaf()) {
-			// It is an internal node which cannot be deleted
-			it->unmark();
-			return;
+		// The deepest node on the way down that stays whatever happens to s;
+		// its child s[idx] heads a chain that may only exist for s.
+		node *keep = &root_;
+		size_t idx = 0;
+		node *it = &root_;
+		for (size_t j = 0, len = s.length(); j < len; ++j) {
+			if (it == &root_ || it->marked() || it->raw_storage().size() != 1) {
+				keep = it;
+				idx = j;
+			}
+			it = it->get_child(s[j]);
+			if (!it) return;
 		}
+		if (!it->marked() || it == &root_) return;
 
-		size_t idx = s.length();
-		do {
-			it = it->parent(); 
-			--idx;
-		} while (!(it->marked()) && it->get_children().size() == 1);
+		--size_;
+		it->unmark();
+		if (it->leaf()) keep->remove_child(s[idx]);
+	}
 
-//FIXME		it->remove_child(s[idx]);
+	// Drops subtries that hold no key and trims spare child capacity in every
+	// node. remove already keeps the trie free of dead branches; this is for
+	// tries that were edited through their nodes, or to reclaim memory after
+	// heavy churn.
+	void compact() {
+		root_.compact();
 	}
 
 	size_t size() const {
 		return size_;
 	}
 
+	// Node count, fan-out and depth histograms and memory, found by walking
+	// the whole trie, plus the operation counters gathered with TRIE_STATS.
+	trie_stats stats() const {
+		trie_stats result;
+		result.keys = size_;
+		if constexpr (!std::is_same_v<arena_type, impl_::no_arena>) {
+			result.arena_bytes = arena_.bytes_reserved();
+		}
+
+		auto bump = [](std::vector<size_t> &histogram, size_t bucket) {
+			if (histogram.size() <= bucket) histogram.resize(bucket + 1);
+			++histogram[bucket];
+		};
+		std::vector<std::pair<const node *, size_t>> stack{ { &root_, 0 } };
+		while (!stack.empty()) {
+			auto [n, depth] = stack.back();
+			stack.pop_back();
+			++result.nodes;
+			bump(result.fanout, n->raw_storage().size());
+			bump(result.depth, depth);
+			result.bytes += impl_::children_bytes(n->raw_storage(), sizeof(node));
+			for (const node &child : n->get_elements()) {
+				stack.push_back({ &child, depth + 1 });
+			}
+		}
+
+		result.find_prefix = { find_prefix_stats_.calls(), find_prefix_stats_.visited() };
+		result.complete_suggestions = { complete_stats_.calls(), complete_stats_.visited() };
+		result.closest_matches = { closest_stats_.calls(), closest_stats_.visited() };
+		return result;
+	}
+
+	// Zeroes the operation counters.
+	void reset_stats() {
+		find_prefix_stats_.reset();
+		complete_stats_.reset();
+		closest_stats_.reset();
+	}
+
+	// Writes the trie in the format read by mapped_trie::open. Needs
+	// frozen_trie.hpp, which does the actual work.
+	template <class Frozen = frozen_trie<CharT, Traits>>
+	void save(const std::string &path) const {
+		Frozen{ *this }.save(path);
+	}
+
 private:
-	std::vector<string> suggestions_impl(const node &n, string_view s) const {
-		std::vector<string> results;
+	// All keys in [first, last) share their first depth characters, which
+	// spell out n. Returns the number of keys that were not already there.
+	template <class ForwardIt>
+	size_t build_sorted_impl(node &n, ForwardIt first, ForwardIt last, size_t depth) {
+		size_t added = 0;
+		for (; first != last && string_view{ *first }.length() == depth; ++first) {
+			if (!n.marked()) {
+				++added;
+				n.mark();
+			}
+		}
 
-		if (n.leaf()) {
-			return results;
+		size_t groups = 0;
+		for (ForwardIt it = first; it != last; ++groups) {
+			it = next_group_(it, last, depth);
 		}
+		if (groups == 0) return added;
+
+		n.reserve_children(groups);
+		while (first != last) {
+			ForwardIt group_last = next_group_(first, last, depth);
+			node *child = n.append_child(string_view{ *first }[depth]);
+			added += build_sorted_impl(*child, first, group_last, depth + 1);
+			first = group_last;
+		}
+		n.refresh_height();
+		return added;
+	}
 
-		string curr;
-		for (const auto &node : n.get_elements()) {
-			curr = s;
-			curr += node.value();
-			if (node.marked()) results.push_back(curr);
-			if (n.leaf()) continue;
-			auto children_res = suggestions_impl(node, curr);
-			results.reserve(results.size() + children_res.size());
-			results.insert(end(results), begin(children_res), end(children_res));
+	void closest_impl(const node &n, impl_::edit_distance_rows<CharT, Traits> &rows, unsigned changes, std::vector<string> &results) const {
+		for (const node &child : n.get_elements()) {
+			unsigned row_min = rows.push(child.value());
+			if (child.marked() && rows.distance() <= changes) results.push_back(rows.candidate());
+			if (row_min <= changes && !child.leaf()) closest_impl(child, rows, changes, results);
+			rows.pop();
 		}
-		return results;
+	}
+
+	template <class ForwardIt>
+	static ForwardIt next_group_(ForwardIt first, ForwardIt last, size_t depth) {
+		CharT c = string_view{ *first }[depth];
+		while (++first != last && Traits::eq(string_view{ *first }[depth], c));
+		return first;
 	}
 
 #ifdef EXPERIMENTAL_CORO
@@ -712,7 +2946,40 @@ private:
 	}
 #endif
 private:
-	node root_{'\0', nullptr, 0, true};
+	using arena_type = typename impl_::storage_arena<Storage<node, CharT, Traits>>::type;
+
+	node make_root_() {
+		if constexpr (std::is_same_v<arena_type, impl_::no_arena>) {
+			return node{ '\0', nullptr, 0, true };
+		}
+		else {
+			using allocator_type = typename Storage<node, CharT, Traits>::allocator_type;
+			return node{ std::allocator_arg, allocator_type{ &arena_ }, '\0', nullptr, 0, true };
+		}
+	}
+
+	// Leaves a moved-from trie empty.
+	void clear_() {
+		root_ = make_root_();
+		size_ = 0;
+	}
+
+	// The arena must outlive the root, so it is declared first.
+	arena_type arena_;
+	node root_ = make_root_();
 	size_t size_{ 0 };
+
+	impl_::op_counter find_prefix_stats_;
+	impl_::op_counter complete_stats_;
+	impl_::op_counter closest_stats_;
 };
 
+// trie whose nodes carry no parent pointer, depth or height: for large tries
+// that are built once and then mostly read. Everything but node::parent and
+// node::depth works as usual; see impl_::no_links.
+template <
+	class CharT = char,
+	class Traits = std::char_traits<CharT>,
+	template <class, class, class> class Storage = impl_::default_vector_storage,
+	template <class> class Accessor = impl_::default_vector_accessor>
+using compact_trie = trie<CharT, 255, Traits, Storage, Accessor, impl_::no_links>;
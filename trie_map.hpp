@@ -0,0 +1,220 @@
+#pragma once
+
+#include "trie.hpp"
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <iterator>
+#include <type_traits>
+#include <cstdint>
+
+namespace impl_
+{
+// Node of a trie_map. Instead of a mark bit, a terminal node holds the index
+// of its value in the map's dense value array.
+template <
+	class CharT,
+	class Traits,
+	template <class, class, class> class Storage = impl_::default_vector_storage,
+	template <class> class Accessor = impl_::default_vector_accessor>
+class map_node_t : public
+	Accessor<Storage<map_node_t<CharT, Traits, Storage, Accessor>, CharT, Traits>>
+{
+	using AccessorT_ = Accessor<Storage<map_node_t, CharT, Traits>>;
+
+public:
+	using value_type = CharT;
+	using traits_type = Traits;
+	using index_type = std::uint32_t;
+
+	static constexpr index_type npos = static_cast<index_type>(-1);
+
+	explicit map_node_t(CharT ch) : value_(ch) {}
+
+	map_node_t *get_or_emplace(CharT ch) {
+		return mut_ptr_cast_(std::addressof(*this->AccessorT_::get_or_emplace(ch, ch)));
+	}
+
+	map_node_t *get_child(CharT ch) {
+		auto it = this->AccessorT_::get(ch);
+		if (it == this->end()) return nullptr;
+		return mut_ptr_cast_(std::addressof(*it));
+	}
+
+	const map_node_t *get_child(CharT ch) const {
+		return const_cast<map_node_t *>(this)->get_child(ch);
+	}
+
+	CharT value() const {
+		return value_;
+	}
+
+	bool marked() const {
+		return index_ != npos;
+	}
+
+	index_type index() const {
+		return index_;
+	}
+
+	void set_index(index_type index) {
+		index_ = index;
+	}
+
+	map_node_t *mut_ptr_cast_(const map_node_t *node) {
+		return const_cast<map_node_t *>(node);
+	}
+
+private:
+	index_type index_ = npos;
+	CharT value_;
+};
+} // namespace impl_
+
+/*****************************************************************************/
+
+// Trie that associates a T with every key. Values live in one dense array in
+// insertion order and terminal nodes store their index, so a lookup is a
+// single walk down the trie.
+template <
+	class CharT,
+	class T,
+	class Traits = std::char_traits<CharT>,
+	template <class, class, class> class Storage = impl_::default_vector_storage,
+	template <class> class Accessor = impl_::default_vector_accessor>
+class trie_map
+{
+public:
+	using node = impl_::map_node_t<CharT, Traits, Storage, Accessor>;
+
+	using string = std::basic_string<CharT, Traits>;
+	using string_view = std::basic_string_view<CharT, Traits>;
+	using mapped_type = T;
+
+	// Key/value pairs below a prefix, in the order of
+	// trie::complete_suggestions. Keys are views into a buffer reused between
+	// elements; see impl_::completion_range.
+	template <class Value>
+	class prefix_range
+	{
+		using completions = impl_::completion_range<node>;
+		using values_pointer = std::conditional_t<std::is_const_v<Value>, const std::vector<T> *, std::vector<T> *>;
+
+	public:
+		class iterator
+		{
+		public:
+			using iterator_category = std::input_iterator_tag;
+			using value_type = std::pair<string_view, Value &>;
+			using difference_type = std::ptrdiff_t;
+			using pointer = void;
+			using reference = value_type;
+
+			iterator() = default;
+
+			value_type operator*() const {
+				return { *it_, (*values_)[it_.node().index()] };
+			}
+
+			iterator &operator++() {
+				++it_;
+				return *this;
+			}
+
+			bool operator==(const iterator &rhs) const {
+				return it_ == rhs.it_;
+			}
+
+			bool operator!=(const iterator &rhs) const {
+				return it_ != rhs.it_;
+			}
+
+		private:
+			friend class prefix_range;
+			iterator(typename completions::iterator it, values_pointer values) : it_(it), values_(values) {}
+
+			typename completions::iterator it_;
+			values_pointer values_ = nullptr;
+		};
+
+		prefix_range(const node *n, string_view prefix, values_pointer values) :
+			completions_(n, prefix), values_(values)
+		{}
+
+		// Single pass: begin may only be called once.
+		iterator begin() {
+			return { completions_.begin(), values_ };
+		}
+
+		iterator end() {
+			return { completions_.end(), values_ };
+		}
+
+	private:
+		completions completions_;
+		values_pointer values_;
+	};
+
+	// Returns the stored value and whether the key was inserted, as opposed
+	// to assigned.
+	template <class M>
+	std::pair<T *, bool> insert_or_assign(string_view s, M &&value) {
+		node *current = &root_;
+		for (size_t j = 0, len = s.length(); j < len; ++j) {
+			current = current->get_or_emplace(s[j]);
+		}
+
+		if (current->marked()) {
+			T &stored = values_[current->index()];
+			stored = std::forward<M>(value);
+			return { &stored, false };
+		}
+		values_.emplace_back(std::forward<M>(value));
+		current->set_index(static_cast<typename node::index_type>(values_.size() - 1));
+		return { &values_.back(), true };
+	}
+
+	// Pointers stay valid until the next insertion.
+	T *find(string_view s) {
+		node *n = find_prefix(s);
+		return n && n->marked() ? &values_[n->index()] : nullptr;
+	}
+
+	const T *find(string_view s) const {
+		return const_cast<trie_map *>(this)->find(s);
+	}
+
+	bool contains(string_view s) const {
+		return find(s) != nullptr;
+	}
+
+	node *find_prefix(string_view s) {
+		node *current = &root_;
+		for (size_t j = 0, len = s.length(); current && j < len; ++j) {
+			current = current->get_child(s[j]);
+		}
+		return current;
+	}
+
+	const node *find_prefix(string_view s) const {
+		return const_cast<trie_map *>(this)->find_prefix(s);
+	}
+
+	prefix_range<T> with_prefix(string_view s) {
+		return { find_prefix(s), s, &values_ };
+	}
+
+	prefix_range<const T> with_prefix(string_view s) const {
+		return { find_prefix(s), s, &values_ };
+	}
+
+	size_t size() const {
+		return values_.size();
+	}
+
+private:
+	node root_{ CharT{} };
+	std::vector<T> values_;
+};
@@ -0,0 +1,258 @@
+#pragma once
+
+#include "trie.hpp"
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <stdexcept>
+#include <cstdint>
+
+namespace impl_
+{
+// Writes the UTF-8 encoding of code point cp to out and returns its length,
+// or 0 if cp is past U+10FFFF. Unpaired surrogates are encoded like any other
+// value of their size (as WTF-8 does), so every encodable key survives the
+// round trip.
+inline size_t utf8_encode(char32_t cp, char (&out)[4]) {
+	if (cp > 0x10FFFF) return 0;
+	if (cp < 0x80) {
+		out[0] = static_cast<char>(cp);
+		return 1;
+	}
+	if (cp < 0x800) {
+		out[0] = static_cast<char>(0xC0 | (cp >> 6));
+		out[1] = static_cast<char>(0x80 | (cp & 0x3F));
+		return 2;
+	}
+	if (cp < 0x10000) {
+		out[0] = static_cast<char>(0xE0 | (cp >> 12));
+		out[1] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+		out[2] = static_cast<char>(0x80 | (cp & 0x3F));
+		return 3;
+	}
+	out[0] = static_cast<char>(0xF0 | (cp >> 18));
+	out[1] = static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+	out[2] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+	out[3] = static_cast<char>(0x80 | (cp & 0x3F));
+	return 4;
+}
+
+// Number of bytes in the sequence that starts with lead byte b.
+inline unsigned utf8_length(unsigned char b) {
+	return b < 0x80 ? 1 : b < 0xE0 ? 2 : b < 0xF0 ? 3 : 4;
+}
+
+// Payload bits of lead byte b.
+inline char32_t utf8_lead_bits(unsigned char b) {
+	return b < 0x80 ? b : b < 0xE0 ? b & 0x1F : b < 0xF0 ? b & 0x0F : b & 0x07;
+}
+
+// Code points of a wide string: UTF-16 when CharT is 16 bits wide (wchar_t
+// on Windows), UTF-32 otherwise. An unpaired surrogate stands for itself.
+template <class CharT, class F>
+void for_each_code_point(std::basic_string_view<CharT> s, F &&f) {
+	for (size_t j = 0, len = s.length(); j < len; ++j) {
+		char32_t cp = static_cast<char32_t>(s[j]);
+		if constexpr (sizeof(CharT) == 2) {
+			cp &= 0xFFFF;
+			if (cp >= 0xD800 && cp < 0xDC00 && j + 1 < len) {
+				char32_t low = static_cast<char32_t>(s[j + 1]) & 0xFFFF;
+				if (low >= 0xDC00 && low < 0xE000) {
+					cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+					++j;
+				}
+			}
+		}
+		f(cp);
+	}
+}
+
+template <class CharT>
+void append_code_point(std::basic_string<CharT> &out, char32_t cp) {
+	if constexpr (sizeof(CharT) == 2) {
+		if (cp >= 0x10000) {
+			cp -= 0x10000;
+			out.push_back(static_cast<CharT>(0xD800 + (cp >> 10)));
+			out.push_back(static_cast<CharT>(0xDC00 + (cp & 0x3FF)));
+			return;
+		}
+	}
+	out.push_back(static_cast<CharT>(cp));
+}
+
+// Encodes s into out. Returns false if s holds a value past U+10FFFF, such
+// as a negative 32 bit wchar_t.
+template <class CharT>
+bool to_utf8(std::basic_string_view<CharT> s, std::string &out) {
+	bool valid = true;
+	out.clear();
+	out.reserve(s.length());
+	for_each_code_point(s, [&](char32_t cp) {
+		char buf[4];
+		size_t len = utf8_encode(cp, buf);
+		valid = valid && len > 0;
+		out.append(buf, len);
+	});
+	return valid;
+}
+
+template <class CharT>
+std::basic_string<CharT> from_utf8(std::string_view s) {
+	std::basic_string<CharT> out;
+	out.reserve(s.length());
+	for (size_t j = 0, len = s.length(); j < len;) {
+		unsigned char lead = static_cast<unsigned char>(s[j]);
+		unsigned n = utf8_length(lead);
+		char32_t cp = utf8_lead_bits(lead);
+		for (unsigned k = 1; k < n && j + k < len; ++k) {
+			cp = (cp << 6) | (static_cast<unsigned char>(s[j + k]) & 0x3F);
+		}
+		append_code_point(out, cp);
+		j += n;
+	}
+	return out;
+}
+} // namespace impl_
+
+/*****************************************************************************/
+
+// Trie over wide-character keys (char32_t, or wchar_t) that stores their
+// UTF-8 encoding. Nodes hold one byte each, so fan-out is at most 256 and the
+// byte-oriented layouts apply: by default the adaptive node4/16/48/256
+// children, and split_vector_storage with simd_vector_accessor works too.
+// UTF-8 sorts like the code points it encodes, so results come in code point
+// order, the same as from a trie<char32_t>, and are handed back as wide
+// strings. For 16 bit input that is not UTF-16 code unit order: keys with
+// characters past U+FFFF sort after those with U+E000..U+FFFF here, but
+// before them in a trie<char16_t>. Keys must be valid code points up to
+// U+10FFFF (unpaired surrogates allowed).
+// A code point past U+007F takes two to four nodes instead of one, so this
+// suits keys that are mostly ASCII. MaxNodeDepth counts bytes.
+template <
+	class CharT = char32_t,
+	size_t MaxNodeDepth = 1023,
+	template <class, class, class> class Storage = impl_::adaptive_storage,
+	template <class> class Accessor = impl_::adaptive_accessor,
+	template <class, class> class Links = impl_::parent_links>
+class utf8_trie
+{
+public:
+	using byte_trie = trie<char, MaxNodeDepth, std::char_traits<char>, Storage, Accessor, Links>;
+	using node = typename byte_trie::node;
+
+	using string = std::basic_string<CharT>;
+	using string_view = std::basic_string_view<CharT>;
+
+	utf8_trie() = default;
+
+	// Throws std::invalid_argument if s holds a value past U+10FFFF.
+	void add(string_view s) {
+		std::string key;
+		if (!impl_::to_utf8(s, key)) throw std::invalid_argument("utf8_trie: code point past U+10FFFF");
+		bytes_.add(key);
+	}
+
+	void remove(string_view s) {
+		std::string key;
+		if (impl_::to_utf8(s, key)) bytes_.remove(key);
+	}
+
+	bool contains(string_view s) const {
+		const node *n = find_prefix(s);
+		return n && n->marked();
+	}
+
+	// The byte node reached by the encoding of s; see trie::find_prefix. The
+	// key is encoded one code point at a time on the way down, so lookups do
+	// not allocate.
+	const node *find_prefix(string_view s) const {
+		const node *current = bytes_.find_prefix({});
+		impl_::for_each_code_point(s, [&](char32_t cp) {
+			char buf[4];
+			size_t len = impl_::utf8_encode(cp, buf);
+			if (len == 0) current = nullptr;
+			for (size_t j = 0; j < len && current; ++j) {
+				current = current->get_child(buf[j]);
+			}
+		});
+		return current;
+	}
+
+	// Same order as trie::complete_suggestions.
+	std::vector<string> complete_suggestions(string_view s) const {
+		std::vector<string> results;
+		std::string prefix;
+		if (!impl_::to_utf8(s, prefix)) return results;
+		for (std::string_view key : bytes_.completions(prefix)) {
+			results.push_back(impl_::from_utf8<CharT>(key));
+		}
+		return results;
+	}
+
+	// Same as trie::closest_matches, with edits counted in code points rather
+	// than bytes: the walk goes down byte by byte, but only pushes a row of
+	// the edit distance table once a whole code point has been read.
+	std::vector<string> closest_matches(string_view s, unsigned changes = 1, bool transpositions = false) const {
+		std::u32string query;
+		impl_::for_each_code_point(s, [&](char32_t cp) {
+			query.push_back(cp);
+		});
+		std::vector<string> results;
+		impl_::edit_distance_rows<char32_t, std::char_traits<char32_t>> rows{ query, changes, transpositions };
+		closest_impl(bytes_.find_prefix({}), rows, changes, 0, 0, results);
+		return results;
+	}
+
+	size_t size() const {
+		return bytes_.size();
+	}
+
+	void compact() {
+		bytes_.compact();
+	}
+
+	// The underlying trie over UTF-8 bytes, e.g. for stats() or to freeze it.
+	const byte_trie &bytes() const {
+		return bytes_;
+	}
+
+private:
+	// partial holds the bits read so far of a code point that still needs
+	// pending continuation bytes.
+	void closest_impl(const node *n, impl_::edit_distance_rows<char32_t, std::char_traits<char32_t>> &rows, unsigned changes,
+		char32_t partial, unsigned pending, std::vector<string> &results) const {
+		for (const node &child : n->get_elements()) {
+			unsigned char b = static_cast<unsigned char>(child.value());
+			char32_t cp;
+			if (pending == 0) {
+				cp = impl_::utf8_lead_bits(b);
+				if (unsigned len = impl_::utf8_length(b); len > 1) {
+					closest_impl(&child, rows, changes, cp, len - 1, results);
+					continue;
+				}
+			}
+			else {
+				cp = (partial << 6) | (b & 0x3F);
+				if (pending > 1) {
+					closest_impl(&child, rows, changes, cp, pending - 1, results);
+					continue;
+				}
+			}
+
+			unsigned row_min = rows.push(cp);
+			if (child.marked() && rows.distance() <= changes) {
+				string key;
+				for (char32_t c : rows.candidate()) {
+					impl_::append_code_point(key, c);
+				}
+				results.push_back(std::move(key));
+			}
+			if (row_min <= changes && !child.leaf()) closest_impl(&child, rows, changes, 0, 0, results);
+			rows.pop();
+		}
+	}
+
+	byte_trie bytes_;
+};